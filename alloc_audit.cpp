@@ -0,0 +1,414 @@
+
+#include "./cf_matrix.h"
+#include "./convert_to_fraction.h"
+#include "./dataset_generator.h"
+#include "./fraction_index.h"
+#include "./fraction_parse.h"
+#include "./prepared_fraction.h"
+#include "./ratio_tracker.h"
+#include "./sharded_convert.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__GLIBC__)
+#include <execinfo.h>
+#include <unistd.h>
+#endif
+
+using namespace cvt_2_fraction;
+
+
+/// <summary>
+/// <para>Allocation audit of the conversion hot paths: every heap allocation made while a workload phase
+/// runs is counted, and the first few are reported with their call stacks. The exit status is 2 when any
+/// phase allocated, so the audit can guard the hot paths in CI.</para>
+///
+/// <para>
+/// With glibc the malloc family itself is interposed, which catches C++ and C allocations alike
+/// (libstdc++'s operator new calls malloc); elsewhere the global operator new/delete are replaced and
+/// only C++ allocations are seen. Each phase is run once unaudited first: one-time setup such as a
+/// thread's trace ring or iostream initialization is not a steady-state cost. Link with -rdynamic to
+/// get function names in the reported call stacks.</para>
+/// </summary>
+namespace
+{
+	namespace audit
+	{
+		constexpr int MaxFrames = 24;
+		constexpr size_t MaxSites = 4;
+
+		struct Site
+		{
+			size_t bytes;
+			int frames;
+			void *stack[MaxFrames];
+		};
+
+		std::atomic<bool> armed{ false };
+		std::atomic<size_t> allocations{ 0 };
+		std::atomic<size_t> bytes{ 0 };
+		std::atomic<size_t> recorded{ 0 };
+		Site sites[MaxSites];
+		thread_local bool inHook = false;    // backtrace() may allocate itself
+
+		void note(size_t size) {
+			if (!armed.load(std::memory_order_relaxed) || inHook)
+				return;
+			inHook = true;
+			allocations.fetch_add(1, std::memory_order_relaxed);
+			bytes.fetch_add(size, std::memory_order_relaxed);
+			size_t slot = recorded.fetch_add(1, std::memory_order_relaxed);
+			if (slot < MaxSites) {
+				sites[slot].bytes = size;
+#if defined(__GLIBC__)
+				sites[slot].frames = backtrace(sites[slot].stack, MaxFrames);
+#else
+				sites[slot].frames = 0;
+#endif
+			}
+			inHook = false;
+		}
+
+		void start() {
+			allocations = 0;
+			bytes = 0;
+			recorded = 0;
+			armed = true;
+		}
+
+		void stop() {
+			armed = false;
+		}
+
+		// with nothing allocated on the way, the stack goes straight to stdout
+		void printSite(const Site &site) {
+			std::cout << std::format("  {} bytes at:\n", site.bytes) << std::flush;
+#if defined(__GLIBC__)
+			backtrace_symbols_fd(site.stack, site.frames, STDOUT_FILENO);
+#else
+			std::cout << "    (no call stacks on this platform)\n";
+#endif
+		}
+	}
+}
+
+
+#if defined(__GLIBC__)
+
+extern "C"
+{
+	void *__libc_malloc(size_t size);
+	void *__libc_calloc(size_t count, size_t size);
+	void *__libc_realloc(void *p, size_t size);
+	void *__libc_memalign(size_t alignment, size_t size);
+
+	void *malloc(size_t size) noexcept {
+		audit::note(size);
+		return __libc_malloc(size);
+	}
+
+	void *calloc(size_t count, size_t size) noexcept {
+		audit::note(count * size);
+		return __libc_calloc(count, size);
+	}
+
+	void *realloc(void *p, size_t size) noexcept {
+		audit::note(size);
+		return __libc_realloc(p, size);
+	}
+
+	void *aligned_alloc(size_t alignment, size_t size) noexcept {
+		audit::note(size);
+		return __libc_memalign(alignment, size);
+	}
+
+	int posix_memalign(void **p, size_t alignment, size_t size) noexcept {
+		audit::note(size);
+		if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0)
+			return EINVAL;
+		*p = __libc_memalign(alignment, size);
+		return *p ? 0 : ENOMEM;
+	}
+}
+
+#else
+
+void *operator new(std::size_t size) {
+	audit::note(size);
+	if (void *p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+	audit::note(size);
+	size_t a = size_t(alignment);
+	if (void *p = std::aligned_alloc(a, (std::max<size_t>(size, 1) + a - 1) / a * a))
+		return p;
+	throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+void *operator new[](std::size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+#endif
+
+
+namespace
+{
+	struct Options
+	{
+		size_t count = 2000;
+		uint64_t seed = 0x5EED;
+		unsigned repeats = 3;
+		double precision = 1E-9;
+	};
+
+	struct Phase
+	{
+		const char *name;
+		std::function<void()> run;
+	};
+
+	// the fractions p/q in [0, 1] with q <= maxDenominator
+	std::vector<Fraction<int64_t>> FareyGrid(int64_t maxDenominator)
+	{
+		std::vector<Fraction<int64_t>> rv;
+		for (int64_t q = 1; q <= maxDenominator; q++) {
+			for (int64_t p = 0; p <= q; p++)
+				rv.emplace_back(p, q);
+		}
+		return rv;
+	}
+
+	// Everything a phase touches is built here, before any auditing starts.
+	struct Workload
+	{
+		std::vector<double> values;             // |v| < 2^31: no conversion throws (exceptions allocate)
+		std::vector<double> unit;               // [0, 1) for int32_t
+		std::vector<Fraction<int32_t>> fractions32;
+		std::vector<Fraction<int64_t>> fractions;
+		PreparedFraction<int64_t> prepared{ Fraction<int64_t>(720, 577) };
+		FractionIndex<int64_t> index{ FareyGrid(64) };
+		std::vector<int32_t> samples;
+		std::vector<int64_t> scaled;
+		std::vector<int64_t> terms;
+		std::vector<size_t> offsets;
+		std::vector<int64_t> num, den;
+		std::vector<size_t> nearest;
+		std::string text;
+		std::vector<sharded::Shard> shards;
+		std::vector<char> records;
+
+		explicit Workload(const Options &opts) {
+			for (size_t k = 0; k < std::size(dataset::DistributionNames); k++) {
+				dataset::Options d;
+				d.kind = dataset::Distribution(k);
+				d.seed = opts.seed + k;
+				d.count = opts.count;
+				for (const dataset::Sample &s : dataset::Generator(d).generate()) {
+					double v = std::abs(s.value);
+					if (v < 0x1p31)
+						values.push_back(s.value);
+					if (v < 1)
+						unit.push_back(v);
+				}
+			}
+			fractions32.resize(unit.size());
+			fractions.resize(values.size());
+			nearest.resize(unit.size());
+
+			std::mt19937_64 rng(opts.seed);
+			samples.resize(opts.count);
+			for (int32_t &x : samples)
+				x = int32_t(uint32_t(rng()));
+			scaled.resize(samples.size());
+
+			// short continued fractions of mixed lengths, the odd one too large for the vector lanes (but not for int64_t)
+			offsets.push_back(0);
+			for (size_t i = 0; i < opts.count; i++) {
+				const bool large = (i % 97 == 0);
+				size_t len = 1 + size_t(rng() % (large ? 3 : 12));
+				for (size_t j = 0; j < len; j++)
+					terms.push_back(j == 0 ? int64_t(rng() % 7) - 3 : 1 + int64_t(rng() % (large ? 100000 : 30)));
+				offsets.push_back(terms.size());
+			}
+			num.resize(opts.count);
+			den.resize(opts.count);
+
+			for (double v : values)
+				text += std::format("{}\n", v);
+			shards = sharded::planShards(text.data(), text.size(), 1);
+			records.resize(values.size() * sharded::TextRecordWidth);
+		}
+	};
+
+	std::vector<Phase> Phases(Workload &w, const Options &opts)
+	{
+		std::vector<Phase> rv;
+		rv.push_back({ "toFract<int32_t>", [&w, &opts] {
+			for (size_t i = 0; i < w.unit.size(); i++)
+				w.fractions32[i] = toFract<int32_t>(w.unit[i], opts.precision);
+		} });
+		rv.push_back({ "toFract<int64_t>", [&w, &opts] {
+			FractionBracket<int64_t> bracket;
+			for (size_t i = 0; i < w.values.size(); i++)
+				w.fractions[i] = toFract<int64_t>(w.values[i], opts.precision, &bracket);
+		} });
+		rv.push_back({ "RatioTracker::update", [&w, &opts] {
+			RatioTracker<int64_t> tracker(opts.precision * 1E3);
+			for (double v : w.unit)
+				tracker.update(v);
+		} });
+		rv.push_back({ "PreparedFraction::apply", [&w] {
+			w.prepared.apply(w.samples, w.scaled, ScaleRounding::Nearest);
+		} });
+		rv.push_back({ "fromCoefficients (batch)", [&w] {
+			fromCoefficients(w.terms, w.offsets, w.num, w.den);
+		} });
+		rv.push_back({ "FractionIndex::nearest (batch)", [&w] {
+			w.index.nearest(std::span<const double>(w.unit), std::span<size_t>(w.nearest));
+		} });
+		rv.push_back({ "sharded::convertShard", [&w, &opts] {
+			sharded::Options so;
+			so.precision = opts.precision;
+			for (const sharded::Shard &s : w.shards)
+				sharded::convertShard<int64_t>(w.text.data(), s, w.records.data() + s.firstRecord * sharded::TextRecordWidth, so);
+		} });
+		rv.push_back({ "toChars / fromChars", [&w] {
+			char buf[48];
+			for (Fraction<int64_t> &f : w.fractions) {
+				auto [end, ec] = toChars(buf, buf + sizeof(buf), f);
+				if (ec == std::errc())
+					fromChars(buf, end, f);
+			}
+		} });
+		rv.push_back({ "std::format_to_n (Fraction formatter)", [&w] {
+			char buf[64];
+			for (const Fraction<int64_t> &f : w.fractions)
+				std::format_to_n(buf, sizeof(buf), "{} ~ {}", f, toFloat(f));
+		} });
+		return rv;
+	}
+
+	// the audit is only meaningful if an allocation is actually seen
+	bool InterceptionWorks()
+	{
+		audit::start();
+		void *volatile p = std::malloc(24);
+		int *volatile q = new int(1);
+		audit::stop();
+		std::free(p);
+		delete q;
+		return audit::allocations >= 2;
+	}
+
+	void Usage(const char *argv0)
+	{
+		std::cerr << std::format(
+			"Usage: {} [options]\n"
+			"\n"
+			"Runs toFract(), the batch paths and the formatters over a dataset with every heap\n"
+			"allocation intercepted; reports the call sites of allocations in steady state and\n"
+			"exits with status 2 if there were any. Builds with DebugReporting print the\n"
+			"diagnostics of every conversion: send stderr to /dev/null.\n"
+			"\n"
+			"  --count N          values per input class (default: 2000)\n"
+			"  --seed S           dataset seed (default: 0x5EED)\n"
+			"  --repeats R        audited passes per phase (default: 3)\n"
+			"  --precision P      toFract precision (default: 1E-9)\n",
+			argv0);
+	}
+}
+
+
+#if defined(BUILD_MONOLITHIC)
+#define main cvt2frac_alloc_audit_main
+#endif
+
+extern "C"
+int main(int argc, const char **argv) {
+	Options opts;
+
+	try {
+		for (int i = 1; i < argc; i++) {
+			std::string_view arg = argv[i];
+			if (arg == "-h" || arg == "--help" || i + 1 >= argc) {
+				Usage(argv[0]);
+				return arg == "-h" || arg == "--help" ? 0 : 1;
+			}
+			const char *v = argv[++i];
+			if (arg == "--count")
+				opts.count = size_t(std::strtoull(v, nullptr, 0));
+			else if (arg == "--seed")
+				opts.seed = std::strtoull(v, nullptr, 0);
+			else if (arg == "--repeats")
+				opts.repeats = unsigned(std::strtoul(v, nullptr, 0));
+			else if (arg == "--precision")
+				opts.precision = std::strtod(v, nullptr);
+			else {
+				Usage(argv[0]);
+				return 1;
+			}
+		}
+
+#if defined(__GLIBC__)
+		// backtrace() loads its unwinder on first use: do that now, not inside the hook
+		void *warmup[1];
+		backtrace(warmup, 1);
+#endif
+		if (!InterceptionWorks()) {
+			std::cerr << "allocation interception is not working in this build; nothing can be audited\n";
+			return 1;
+		}
+
+		Workload workload(opts);
+		size_t dirty = 0;
+		for (Phase &phase : Phases(workload, opts)) {
+			phase.run();
+
+			audit::start();
+			for (unsigned r = 0; r < opts.repeats; r++)
+				phase.run();
+			audit::stop();
+
+			size_t n = audit::allocations;
+			if (n == 0) {
+				std::cout << std::format("{:<40} ok\n", phase.name);
+				continue;
+			}
+			dirty++;
+			std::cout << std::format("{:<40} {} allocation(s), {} bytes in {} pass(es)\n", phase.name, n, size_t(audit::bytes), opts.repeats);
+			for (size_t s = 0; s < std::min(n, audit::MaxSites); s++)
+				audit::printSite(audit::sites[s]);
+		}
+
+		if (dirty) {
+			std::cout << std::format("{} phase(s) allocated in steady state\n", dirty);
+			return 2;
+		}
+	}
+	catch (const std::exception &ex) {
+		std::cerr << ex.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,223 @@
+
+#pragma once
+
+#include "./convert_to_fraction.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// The Arrow C Data Interface structures, verbatim from the specification
+// (https://arrow.apache.org/docs/format/CDataInterface.html); no Arrow library is needed.
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+	// Array type description
+	const char* format;
+	const char* name;
+	const char* metadata;
+	int64_t flags;
+	int64_t n_children;
+	struct ArrowSchema** children;
+	struct ArrowSchema* dictionary;
+
+	// Release callback
+	void (*release)(struct ArrowSchema*);
+	// Opaque producer-specific data
+	void* private_data;
+};
+
+struct ArrowArray {
+	// Array data description
+	int64_t length;
+	int64_t null_count;
+	int64_t offset;
+	int64_t n_buffers;
+	int64_t n_children;
+	const void** buffers;
+	struct ArrowArray** children;
+	struct ArrowArray* dictionary;
+
+	// Release callback
+	void (*release)(struct ArrowArray*);
+	// Opaque producer-specific data
+	void* private_data;
+};
+
+#endif  // ARROW_C_DATA_INTERFACE
+
+namespace cvt_2_fraction
+{
+	/// <summary>
+	/// <para>Batch conversion of Arrow columns through the C Data Interface.</para>
+	///
+	/// <para>
+	/// toFractions() reads a float64 ("g") or float32 ("f") array in place, honouring its offset and
+	/// validity bitmap, and exports a struct array ("+s") with the non-nullable int64 children
+	/// "numerator" and "denominator", written directly into the exported buffers: no column is copied
+	/// on the way in or out. The consumer owns the result and frees it through its release callbacks
+	/// as usual; the children may be moved out individually.</para>
+	///
+	/// <para>
+	/// Input nulls stay null. Values toFract() cannot represent (NaN, infinities, magnitudes of 2^63 and
+	/// beyond) become null as well; their child slots hold 0/1.</para>
+	/// </summary>
+	namespace arrow
+	{
+		namespace detail
+		{
+			constexpr std::align_val_t BufferAlignment{ 64 };   // the alignment Arrow recommends
+
+			struct AlignedDelete
+			{
+				void operator()(void *p) const { ::operator delete(p, BufferAlignment); }
+			};
+
+			using Buffer = std::unique_ptr<void, AlignedDelete>;
+
+			inline Buffer allocate(size_t bytes) {
+				return Buffer(::operator new(std::max<size_t>(bytes, 1), BufferAlignment));
+			}
+
+			struct ArrayData
+			{
+				Buffer buffers[2];
+				const void *pointers[2] = { nullptr, nullptr };
+				ArrowArray children[2] = {};
+				ArrowArray *childPointers[2] = { &children[0], &children[1] };
+			};
+
+			inline void releaseArray(ArrowArray *array) {
+				for (int64_t i = 0; i < array->n_children; i++) {
+					ArrowArray *child = array->children[i];
+					if (child->release)
+						child->release(child);
+				}
+				delete static_cast<ArrayData *>(array->private_data);
+				array->release = nullptr;
+			}
+
+			struct SchemaData
+			{
+				std::string name;
+				ArrowSchema children[2] = {};
+				ArrowSchema *childPointers[2] = { &children[0], &children[1] };
+			};
+
+			inline void releaseSchema(ArrowSchema *schema) {
+				for (int64_t i = 0; i < schema->n_children; i++) {
+					ArrowSchema *child = schema->children[i];
+					if (child->release)
+						child->release(child);
+				}
+				delete static_cast<SchemaData *>(schema->private_data);
+				schema->release = nullptr;
+			}
+
+			// child schemas only point at string literals
+			inline void releaseChildSchema(ArrowSchema *schema) {
+				schema->release = nullptr;
+			}
+
+			inline bool isValid(const uint8_t *validity, int64_t i) {
+				return !validity || (validity[i >> 3] >> (i & 7)) & 1;
+			}
+
+			template<typename float_type>
+			int64_t convert(const float_type *values, const uint8_t *validity, int64_t offset, int64_t length, double Precision,
+					int64_t *num, int64_t *den, uint8_t *outValidity)
+				{
+					int64_t nulls = 0;
+					for (int64_t i = 0; i < length; i++) {
+						double v = double(values[offset + i]);
+						if (isValid(validity, offset + i) && std::abs(v) < 0x1p63) {
+							Fraction<int64_t> f = toFract<int64_t>(v, Precision);
+							num[i] = f.numerator();
+							den[i] = f.denominator();
+							outValidity[i >> 3] |= uint8_t(1u << (i & 7));
+						}
+						else {
+							num[i] = 0;
+							den[i] = 1;
+							nulls++;
+						}
+					}
+					return nulls;
+				}
+		}
+
+		/// <summary>
+		/// Convert a float64/float32 Arrow array into a struct array of int64 numerator/denominator pairs.
+		/// `out` and `outSchema` must not hold live data: they are overwritten.
+		/// </summary>
+		inline void toFractions(const ArrowSchema &schema, const ArrowArray &array, double Precision,
+				ArrowArray &out, ArrowSchema &outSchema)
+			{
+				const std::string_view format = (schema.format ? schema.format : "");
+				if (format != "g" && format != "f")
+					throw std::invalid_argument(std::format("toFractions: unsupported Arrow format '{}' (need float64 'g' or float32 'f')", format));
+				if (!array.release)
+					throw std::invalid_argument("toFractions: the input array has been released");
+				if (array.n_buffers != 2 || array.length < 0 || array.offset < 0)
+					throw std::invalid_argument(std::format("toFractions: malformed primitive array ({} buffers, length {}, offset {})",
+						array.n_buffers, array.length, array.offset));
+
+				const int64_t n = array.length;
+				const size_t bitmapBytes = size_t((n + 7) / 8);
+				auto data = std::make_unique<detail::ArrayData>();
+				detail::Buffer num = detail::allocate(size_t(n) * sizeof(int64_t));
+				detail::Buffer den = detail::allocate(size_t(n) * sizeof(int64_t));
+				data->buffers[0] = detail::allocate(bitmapBytes);
+				std::memset(data->buffers[0].get(), 0, bitmapBytes);
+
+				const uint8_t *validity = (array.null_count != 0 ? static_cast<const uint8_t *>(array.buffers[0]) : nullptr);
+				uint8_t *outValidity = static_cast<uint8_t *>(data->buffers[0].get());
+				int64_t nulls = (format == "g")
+					? detail::convert(static_cast<const double *>(array.buffers[1]), validity, array.offset, n, Precision,
+						static_cast<int64_t *>(num.get()), static_cast<int64_t *>(den.get()), outValidity)
+					: detail::convert(static_cast<const float *>(array.buffers[1]), validity, array.offset, n, Precision,
+						static_cast<int64_t *>(num.get()), static_cast<int64_t *>(den.get()), outValidity);
+
+				// the children: plain int64 arrays whose value buffers are the ones just written
+				auto childData = [&](detail::Buffer values) {
+					auto rv = std::make_unique<detail::ArrayData>();
+					rv->buffers[1] = std::move(values);
+					rv->pointers[1] = rv->buffers[1].get();
+					return rv;
+				};
+				std::unique_ptr<detail::ArrayData> children[2] = { childData(std::move(num)), childData(std::move(den)) };
+				for (int c = 0; c < 2; c++) {
+					ArrowArray &child = data->children[c];
+					child = ArrowArray{ n, 0, 0, 2, 0, children[c]->pointers, nullptr, nullptr, detail::releaseArray, nullptr };
+					child.private_data = children[c].release();
+				}
+
+				if (nulls)
+					data->pointers[0] = data->buffers[0].get();
+				else
+					data->buffers[0].reset();
+
+				out = ArrowArray{ n, nulls, 0, 1, 2, data->pointers, data->childPointers, nullptr, detail::releaseArray, nullptr };
+				out.private_data = data.release();
+
+				auto schemaData = std::make_unique<detail::SchemaData>();
+				schemaData->name = (schema.name ? schema.name : "");
+				const char *names[2] = { "numerator", "denominator" };
+				for (int c = 0; c < 2; c++)
+					schemaData->children[c] = ArrowSchema{ "l", names[c], nullptr, 0, 0, nullptr, nullptr, detail::releaseChildSchema, nullptr };
+				outSchema = ArrowSchema{ "+s", schemaData->name.c_str(), nullptr, ARROW_FLAG_NULLABLE, 2, schemaData->childPointers, nullptr,
+					detail::releaseSchema, nullptr };
+				outSchema.private_data = schemaData.release();
+			}
+	}
+}
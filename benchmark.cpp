@@ -0,0 +1,546 @@
+
+// the diagnostic output of toFract() would dominate every measurement
+#define CVT2FRAC_DEBUG_REPORTING 0
+
+#include "./cf_arithmetic.h"
+#include "./convert_to_fraction.h"
+#include "./dataset_generator.h"
+#include "./perf_counters.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace cvt_2_fraction;
+
+
+namespace
+{
+	enum class Engine
+	{
+		Mediant,            // toFract()
+		ContinuedFraction,  // toFraction() over the classic expansion of the double
+	};
+
+	constexpr const char *EngineNames[] = { "mediant", "cf" };
+
+	Engine ParseEngine(std::string_view name)
+	{
+		for (size_t i = 0; i < std::size(EngineNames); i++) {
+			if (name == EngineNames[i])
+				return Engine(i);
+		}
+		throw std::invalid_argument(std::format("unknown engine '{}'", name));
+	}
+
+	struct Scenario
+	{
+		dataset::Distribution kind;
+		int intBits;
+		double precision;
+		Engine engine;
+
+		std::string name() const {
+			return std::format("{}/int{}/{:g}/{}", dataset::toString(kind), intBits, precision, EngineNames[int(engine)]);
+		}
+	};
+
+	struct Options
+	{
+		std::vector<dataset::Distribution> kinds;
+		std::vector<int> intBits = { 32, 64 };
+		std::vector<double> precisions = { 1E-9 };
+		std::vector<Engine> engines;
+		size_t count = 100000;
+		uint64_t seed = 0x5EED;
+		unsigned repeats = 11;
+		bool perf = true;
+		std::string saveBaseline;
+		std::string compareBaseline;
+		double threshold = 5;   // percent
+	};
+
+	// per-conversion figures of one timed pass over the dataset
+	using Measurement = PerfCounters::Sample;
+
+	volatile int64_t sink;
+
+	template<typename int_type>
+	Fraction<int_type> ToFractionCF(double val, double precision)
+	{
+		// a_k = floor(x), x <- 1 / (x - a_k): no deeper than the double itself can resolve, and ending
+		// at the first term outside int_type (toFraction() stops where the convergents overflow)
+		const double limit = -double(std::numeric_limits<int_type>::min());     // 2^(bits - 1), exact
+		double x = val;
+		bool end = false;
+		GeneratorCF<int_type> stream([&x, &end, limit](int_type &term) {
+			if (end || !(std::abs(x) < 0x1p62))
+				return false;
+			double a = std::floor(x);
+			if (!(a >= -limit && a < limit))
+				return false;
+			term = int_type(a);
+			end = (x == a);
+			x = 1 / (x - a);
+			return true;
+		});
+		return toFraction<int_type, int_type>(stream, precision);
+	}
+
+	template<typename int_type>
+	Measurement RunOnce(PerfCounters &counters, const std::vector<double> &values, double precision, Engine engine)
+	{
+		int64_t checksum = 0;
+		counters.start();
+		for (double v : values) {
+			Fraction<int_type> f = (engine == Engine::Mediant)
+				? toFract<int_type>(v, precision)
+				: ToFractionCF<int_type>(v, precision);
+			checksum += int64_t(f.numerator()) ^ int64_t(f.denominator());
+		}
+		Measurement m = counters.stop();
+		sink = checksum;
+
+		m.nanoseconds /= double(values.size());
+		for (double &c : m.counts) {
+			if (c >= 0)
+				c /= double(values.size());
+		}
+		return m;
+	}
+
+	std::vector<Measurement> RunScenario(PerfCounters &counters, const Scenario &sc, const Options &opts)
+	{
+		dataset::Options dopts;
+		dopts.kind = sc.kind;
+		dopts.count = opts.count;
+		dopts.seed = opts.seed;
+		if (sc.kind == dataset::Distribution::HeavyTailed)
+			dopts.maxMagnitude = (sc.intBits == 32 ? 1E9 : 1E18);
+
+		std::vector<double> values;
+		for (const dataset::Sample &s : dataset::generate(dopts))
+			values.push_back(s.value);
+
+		std::vector<Measurement> runs;
+		// one untimed pass to warm caches and branch predictors
+		for (unsigned r = 0; r <= opts.repeats; r++) {
+			Measurement m = (sc.intBits == 32)
+				? RunOnce<int32_t>(counters, values, sc.precision, sc.engine)
+				: RunOnce<int64_t>(counters, values, sc.precision, sc.engine);
+			if (r > 0)
+				runs.push_back(m);
+		}
+		return runs;
+	}
+
+	double Median(std::vector<double> v)
+	{
+		if (v.empty())
+			return 0;
+		std::sort(v.begin(), v.end());
+		size_t n = v.size();
+		return (n & 1) ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+	}
+
+	/// <summary>
+	/// Median of the per-conversion times with a distribution-free ~95% confidence interval: the order
+	/// statistics at n/2 -+ 0.98 sqrt(n) (normal approximation of the binomial sign test).
+	/// </summary>
+	struct Summary
+	{
+		double median = 0;
+		double low = 0;
+		double high = 0;
+		std::vector<double> runs;
+	};
+
+	Summary Summarize(std::vector<double> runs)
+	{
+		Summary rv;
+		rv.median = Median(runs);
+		std::sort(runs.begin(), runs.end());
+		if (!runs.empty()) {
+			double n = double(runs.size());
+			double spread = 0.98 * std::sqrt(n);
+			size_t lo = size_t(std::max(0.0, std::floor(n / 2 - spread)));
+			size_t hi = size_t(std::min(n - 1, std::ceil(n / 2 + spread) - 1));
+			rv.low = runs[std::min(lo, runs.size() - 1)];
+			rv.high = runs[std::max(hi, lo)];
+		}
+		rv.runs = std::move(runs);
+		return rv;
+	}
+
+	Summary Report(const Scenario &sc, const std::vector<Measurement> &runs, bool perf)
+	{
+		std::vector<double> ns;
+		for (const Measurement &m : runs)
+			ns.push_back(m.nanoseconds);
+		Summary summary = Summarize(ns);
+		std::string line = std::format("{:<40} {:>9.2f} ns [{:.2f}, {:.2f}]", sc.name(), summary.median, summary.low, summary.high);
+
+		if (perf) {
+			for (int e = 0; e < PerfCounters::EventCount; e++) {
+				std::vector<double> c;
+				for (const Measurement &m : runs) {
+					if (m.counts[e] >= 0)
+						c.push_back(m.counts[e]);
+				}
+				if (c.empty())
+					line += std::format("  {:>9} {}", "n/a", PerfCounters::EventNames[e]);
+				else
+					line += std::format("  {:>9.2f} {}", Median(c), PerfCounters::EventNames[e]);
+			}
+		}
+		std::cout << line << std::endl;
+		return summary;
+	}
+
+	/// <summary>
+	/// Just enough JSON for the baseline files: objects, arrays, strings without \u escapes, numbers,
+	/// true/false/null.
+	/// </summary>
+	struct Json
+	{
+		enum Type { Null, Bool, Number, String, Array, Object } type = Null;
+		double number = 0;
+		std::string string;
+		std::vector<Json> items;
+		std::map<std::string, Json> members;
+
+		const Json &operator[](const std::string &key) const {
+			auto it = members.find(key);
+			if (type != Object || it == members.end())
+				throw std::runtime_error(std::format("baseline: missing field '{}'", key));
+			return it->second;
+		}
+	};
+
+	class JsonReader
+	{
+	public:
+		explicit JsonReader(std::string_view text)
+			: text(text)
+		{}
+
+		Json parse() {
+			Json rv = value();
+			skip();
+			if (pos != text.size())
+				fail();
+			return rv;
+		}
+
+	private:
+		[[noreturn]] void fail() const {
+			throw std::runtime_error(std::format("baseline: malformed JSON at offset {}", pos));
+		}
+
+		void skip() {
+			while (pos < text.size() && std::isspace((unsigned char)text[pos]))
+				pos++;
+		}
+
+		bool accept(char c) {
+			skip();
+			if (pos < text.size() && text[pos] == c) {
+				pos++;
+				return true;
+			}
+			return false;
+		}
+
+		void expect(char c) {
+			if (!accept(c))
+				fail();
+		}
+
+		std::string str() {
+			expect('"');
+			std::string rv;
+			while (pos < text.size() && text[pos] != '"') {
+				char c = text[pos++];
+				if (c == '\\') {
+					if (pos >= text.size())
+						fail();
+					c = text[pos++];
+					switch (c) {
+					case 'n': c = '\n'; break;
+					case 't': c = '\t'; break;
+					case '"': case '\\': case '/': break;
+					default: fail();
+					}
+				}
+				rv += c;
+			}
+			expect('"');
+			return rv;
+		}
+
+		Json value() {
+			Json rv;
+			skip();
+			if (pos >= text.size())
+				fail();
+			char c = text[pos];
+			if (c == '{') {
+				pos++;
+				rv.type = Json::Object;
+				if (accept('}'))
+					return rv;
+				do {
+					std::string key = str();
+					expect(':');
+					rv.members[key] = value();
+				} while (accept(','));
+				expect('}');
+			}
+			else if (c == '[') {
+				pos++;
+				rv.type = Json::Array;
+				if (accept(']'))
+					return rv;
+				do {
+					rv.items.push_back(value());
+				} while (accept(','));
+				expect(']');
+			}
+			else if (c == '"') {
+				rv.type = Json::String;
+				rv.string = str();
+			}
+			else if (text.substr(pos, 4) == "true" || text.substr(pos, 5) == "false") {
+				rv.type = Json::Bool;
+				rv.number = (c == 't');
+				pos += (c == 't' ? 4 : 5);
+			}
+			else if (text.substr(pos, 4) == "null") {
+				pos += 4;
+			}
+			else {
+				std::string num(text.substr(pos, std::min<size_t>(text.size() - pos, 64)));
+				char *end;
+				rv.type = Json::Number;
+				rv.number = std::strtod(num.c_str(), &end);
+				if (end == num.c_str())
+					fail();
+				pos += size_t(end - num.c_str());
+			}
+			return rv;
+		}
+
+		std::string_view text;
+		size_t pos = 0;
+	};
+
+	std::string JsonString(std::string_view s)
+	{
+		std::string rv = "\"";
+		for (char c : s) {
+			if (c == '"' || c == '\\')
+				rv += '\\';
+			rv += c;
+		}
+		return rv + "\"";
+	}
+
+	using Results = std::vector<std::pair<std::string, Summary>>;
+
+	void SaveBaseline(const std::string &path, const Options &opts, const Results &results)
+	{
+		std::ofstream os(path);
+		if (!os)
+			throw std::runtime_error(std::format("cannot write baseline '{}'", path));
+		os << std::format("{{\n  \"version\": 1,\n  \"count\": {},\n  \"seed\": {},\n  \"repeats\": {},\n  \"scenarios\": [",
+			opts.count, opts.seed, opts.repeats);
+		for (size_t i = 0; i < results.size(); i++) {
+			const Summary &s = results[i].second;
+			std::string runs;
+			for (double r : s.runs)
+				runs += std::format("{}{}", runs.empty() ? "" : ", ", r);
+			os << std::format("{}\n    {{ \"name\": {}, \"median_ns\": {}, \"ci_low_ns\": {}, \"ci_high_ns\": {}, \"runs_ns\": [{}] }}",
+				i ? "," : "", JsonString(results[i].first), s.median, s.low, s.high, runs);
+		}
+		os << "\n  ]\n}\n";
+		if (!os)
+			throw std::runtime_error(std::format("cannot write baseline '{}'", path));
+	}
+
+	/// <summary>
+	/// Compare against a saved baseline. A scenario regresses when its median is more than `threshold`
+	/// percent slower and the confidence intervals don't overlap; returns the number of regressions.
+	/// </summary>
+	int CompareBaseline(const std::string &path, const Options &opts, const Results &results)
+	{
+		std::ifstream is(path);
+		if (!is)
+			throw std::runtime_error(std::format("cannot read baseline '{}'", path));
+		std::stringstream buf;
+		buf << is.rdbuf();
+		Json doc = JsonReader(buf.str()).parse();
+		if (doc["version"].number != 1)
+			throw std::runtime_error(std::format("baseline '{}': unsupported version {}", path, doc["version"].number));
+		if (doc["count"].number != double(opts.count) || doc["seed"].number != double(opts.seed))
+			std::cerr << std::format("warning: baseline was measured with --count {} --seed {}\n", doc["count"].number, doc["seed"].number);
+
+		std::map<std::string, Summary> base;
+		for (const Json &sc : doc["scenarios"].items) {
+			Summary s;
+			s.median = sc["median_ns"].number;
+			s.low = sc["ci_low_ns"].number;
+			s.high = sc["ci_high_ns"].number;
+			base[sc["name"].string] = s;
+		}
+
+		int regressions = 0;
+		std::cout << std::format("\n{:<40} {:>10} {:>10} {:>8}\n", "scenario", "baseline", "current", "change");
+		for (const auto &[name, cur] : results) {
+			auto it = base.find(name);
+			if (it == base.end()) {
+				std::cout << std::format("{:<40} {:>10} {:>10.2f} {:>8}  new\n", name, "-", cur.median, "");
+				continue;
+			}
+			const Summary &old = it->second;
+			double change = (old.median > 0 ? (cur.median / old.median - 1) * 100 : 0);
+			const char *verdict = "";
+			if (change > opts.threshold && cur.low > old.high) {
+				verdict = "REGRESSION";
+				regressions++;
+			}
+			else if (change < -opts.threshold && cur.high < old.low)
+				verdict = "improved";
+			std::cout << std::format("{:<40} {:>10.2f} {:>10.2f} {:>+7.1f}%  {}\n", name, old.median, cur.median, change, verdict);
+			base.erase(it);
+		}
+		for (const auto &[name, old] : base)
+			std::cout << std::format("{:<40} {:>10.2f} {:>10} {:>8}  not run\n", name, old.median, "-", "");
+
+		if (regressions)
+			std::cout << std::format("{} scenario(s) regressed by more than {}%\n", regressions, opts.threshold);
+		return regressions;
+	}
+
+	void Usage(const char *argv0)
+	{
+		std::cerr << std::format(
+			"Usage: {} [options]\n"
+			"\n"
+			"Times one conversion (median over the repeats, with its 95% confidence interval)\n"
+			"for every scenario input class x int type x precision x engine, with hardware\n"
+			"counters where available.\n"
+			"\n"
+			"  --kind NAME        input class (repeatable; default: all, see dataset_generator)\n"
+			"  --int 32|64        int_type width (repeatable; default: 32 and 64)\n"
+			"  --precision P      toFract precision (repeatable; default: 1E-9)\n"
+			"  --engine NAME      mediant (toFract) or cf (repeatable; default: both)\n"
+			"  --count N          values per dataset (default: 100000)\n"
+			"  --seed S           dataset seed (default: 0x5EED)\n"
+			"  --repeats R        timed passes per scenario (default: 11)\n"
+			"  --no-perf          wall clock only, don't open hardware counters\n"
+			"  --save-baseline F  write the results to JSON file F\n"
+			"  --compare F        compare with baseline F; exit status 2 on regressions\n"
+			"  --threshold PCT    slowdown that counts as a regression (default: 5)\n",
+			argv0);
+	}
+}
+
+
+#if defined(BUILD_MONOLITHIC)
+#define main cvt2frac_benchmark_main
+#endif
+
+extern "C"
+int main(int argc, const char **argv) {
+	Options opts;
+	bool userInts = false, userPrecisions = false;
+
+	try {
+		for (int i = 1; i < argc; i++) {
+			std::string_view arg = argv[i];
+			if (arg == "--no-perf") {
+				opts.perf = false;
+				continue;
+			}
+			if (arg == "-h" || arg == "--help" || i + 1 >= argc) {
+				Usage(argv[0]);
+				return arg == "-h" || arg == "--help" ? 0 : 1;
+			}
+			const char *v = argv[++i];
+			if (arg == "--kind")
+				opts.kinds.push_back(dataset::parseDistribution(v));
+			else if (arg == "--int") {
+				if (!userInts)
+					opts.intBits.clear();
+				userInts = true;
+				opts.intBits.push_back(std::atoi(v) == 32 ? 32 : 64);
+			}
+			else if (arg == "--precision") {
+				if (!userPrecisions)
+					opts.precisions.clear();
+				userPrecisions = true;
+				opts.precisions.push_back(std::strtod(v, nullptr));
+			}
+			else if (arg == "--count")
+				opts.count = size_t(std::strtoull(v, nullptr, 0));
+			else if (arg == "--seed")
+				opts.seed = std::strtoull(v, nullptr, 0);
+			else if (arg == "--engine")
+				opts.engines.push_back(ParseEngine(v));
+			else if (arg == "--repeats")
+				opts.repeats = unsigned(std::strtoul(v, nullptr, 0));
+			else if (arg == "--save-baseline")
+				opts.saveBaseline = v;
+			else if (arg == "--compare")
+				opts.compareBaseline = v;
+			else if (arg == "--threshold")
+				opts.threshold = std::strtod(v, nullptr);
+			else {
+				Usage(argv[0]);
+				return 1;
+			}
+		}
+		if (opts.kinds.empty()) {
+			for (size_t k = 0; k < std::size(dataset::DistributionNames); k++)
+				opts.kinds.push_back(dataset::Distribution(k));
+		}
+		if (opts.engines.empty())
+			opts.engines = { Engine::Mediant, Engine::ContinuedFraction };
+
+		PerfCounters counters(opts.perf);
+		if (opts.perf && !counters.available())
+			std::cerr << "hardware counters unavailable; reporting wall clock time only\n";
+
+		Results results;
+		for (dataset::Distribution kind : opts.kinds) {
+			for (int bits : opts.intBits) {
+				for (double precision : opts.precisions) {
+					for (Engine engine : opts.engines) {
+						Scenario sc{ kind, bits, precision, engine };
+						results.emplace_back(sc.name(), Report(sc, RunScenario(counters, sc, opts), counters.available()));
+					}
+				}
+			}
+		}
+
+		if (!opts.saveBaseline.empty())
+			SaveBaseline(opts.saveBaseline, opts, results);
+		if (!opts.compareBaseline.empty() && CompareBaseline(opts.compareBaseline, opts, results) > 0)
+			return 2;
+	}
+	catch (const std::exception &ex) {
+		std::cerr << ex.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
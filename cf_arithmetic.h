@@ -0,0 +1,487 @@
+
+#pragma once
+
+#include "./convert_to_fraction.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace cvt_2_fraction
+{
+	/// <summary>
+	/// <para>Lazy arithmetic on continued fractions (Gosper's algorithms).</para>
+	///
+	/// <para>
+	/// A CFStream produces the coefficients [a0; a1, a2, ...] of a real number one at a time (a0 may be
+	/// negative, all later terms are positive). Homographic computes (a*x + b) / (c*x + d) and Bihomographic
+	/// (a*x*y + b*x + c*y + d) / (e*x*y + f*x + g*y + h) of input streams, consuming input terms only until the
+	/// next output term is determined. Chains such as gear ratio products, timebase sums or reciprocals are
+	/// thus evaluated exactly, to whatever precision toFraction() asks for, without materializing
+	/// intermediate rationals (whose numerators and denominators multiply up and overflow) or rounding
+	/// through double.</para>
+	///
+	/// <para>
+	/// An exact rational result of irrational inputs (e.g. sqrt(2) * sqrt(2)) can never be decided from a
+	/// finite number of input terms. After maxIngest input terms without output, or when ingesting another
+	/// term would overflow int_type, the stream emits the nearest integer of the remaining (by then normally
+	/// tiny) interval and ends; approximate() reports when that happened. Overflow while emitting throws
+	/// std::overflow_error. Use a multiprecision int_type for very long chains.</para>
+	/// </summary>
+	template<typename int_type>
+	class CFStream
+	{
+	public:
+		virtual ~CFStream() = default;
+
+		/// <summary>
+		/// Produce the next coefficient; false at the end of a finite (rational) expansion.
+		/// </summary>
+		virtual bool next(int_type &term) = 0;
+
+		virtual bool approximate() const { return false; }
+	};
+
+	template<typename int_type>
+	using CFStreamPtr = std::unique_ptr<CFStream<int_type>>;
+
+	namespace detail
+	{
+		template<typename int_type>
+		int_type floorDiv(int_type a, int_type b) {
+			int_type q = a / b;
+			if ((a % b != 0) && ((a < 0) != (b < 0)))
+				q--;
+			return q;
+		}
+
+		// MinValue / -1 has no representation
+		template<typename int_type>
+		bool quotientOverflows(int_type a, int_type b) {
+			if constexpr (std::numeric_limits<int_type>::is_bounded && std::numeric_limits<int_type>::is_signed)
+				return b == -1 && a == std::numeric_limits<int_type>::min();
+			return false;
+		}
+
+		template<typename int_type>
+		int_type mulAdd(int_type a, int_type p, int_type b) {
+			int_type t;
+			if (checkedMul(a, p, t) || checkedAdd(t, b, t))
+				throw std::overflow_error("continued fraction state overflow");
+			return t;
+		}
+
+		template<typename int_type>
+		int_type mulSub(int_type a, int_type r, int_type b) {
+			// a - r * b; the product must have a negation
+			int_type t;
+			bool overflow = checkedMul(r, b, t);
+			if constexpr (std::numeric_limits<int_type>::is_bounded)
+				overflow = overflow || t == std::numeric_limits<int_type>::min();
+			if (overflow || checkedAdd(a, int_type(-t), t))
+				throw std::overflow_error("continued fraction state overflow");
+			return t;
+		}
+
+		/// <summary>
+		/// The common floor of all ratios num[i]/den[i] (pairs that are 0/0 don't constrain the value), or false
+		/// when it is not determined yet: a denominator is zero or changes sign, or the floors differ.
+		/// </summary>
+		template<typename int_type, size_t N>
+		bool commonFloor(const int_type (&num)[N], const int_type (&den)[N], int_type &r, bool &allZero) {
+			bool have = false;
+			bool positive = false;
+			allZero = true;
+			for (size_t i = 0; i < N; i++) {
+				if (num[i] == 0 && den[i] == 0)
+					continue;
+				allZero = false;
+				if (den[i] == 0 || quotientOverflows(num[i], den[i]))
+					return false;
+				int_type q = floorDiv(num[i], den[i]);
+				if (!have) {
+					r = q;
+					positive = (den[i] > 0);
+					have = true;
+				}
+				else if (q != r || (den[i] > 0) != positive) {
+					return false;
+				}
+			}
+			return have;
+		}
+
+		/// <summary>
+		/// A term for a state whose ratios num[i]/den[i] no longer share a floor: the midpoint of the lowest
+		/// and the highest floor, rounded up, all in integers (0 when every denominator is zero).
+		/// </summary>
+		template<typename int_type, size_t N>
+		int_type nearestOfInterval(const int_type (&num)[N], const int_type (&den)[N]) {
+			bool have = false;
+			int_type lo = 0, hi = 0;
+			for (size_t i = 0; i < N; i++) {
+				if (den[i] == 0)
+					continue;
+				int_type q = (quotientOverflows(num[i], den[i]) ? std::numeric_limits<int_type>::max() : floorDiv(num[i], den[i]));
+				lo = (have ? std::min(lo, q) : q);
+				hi = (have ? std::max(hi, q) : q);
+				have = true;
+			}
+			// floor((lo + hi + 1) / 2) without forming lo + hi
+			return lo / 2 + hi / 2 + floorDiv(int_type(lo % 2 + hi % 2 + 1), int_type(2));
+		}
+	}
+
+	/// <summary>
+	/// The (finite) expansion of a fraction: Euclid's algorithm with floor division.
+	/// </summary>
+	template<typename int_type>
+	class FractionCF : public CFStream<int_type>
+	{
+	public:
+		explicit FractionCF(const Fraction<int_type> &frac)
+			: num(frac.numerator()), den(frac.denominator())
+		{}
+
+		bool next(int_type &term) override {
+			if (den == 0)
+				return false;
+			term = detail::floorDiv(num, den);
+			int_type r = num - term * den;
+			num = den;
+			den = r;
+			return true;
+		}
+
+	private:
+		int_type num;
+		int_type den;
+	};
+
+	/// <summary>
+	/// Coefficients supplied by a callable, e.g. a periodic expansion of a quadratic irrational.
+	/// </summary>
+	template<typename int_type>
+	class GeneratorCF : public CFStream<int_type>
+	{
+	public:
+		explicit GeneratorCF(std::function<bool(int_type &)> gen)
+			: gen(std::move(gen))
+		{}
+
+		bool next(int_type &term) override {
+			return gen(term);
+		}
+
+	private:
+		std::function<bool(int_type &)> gen;
+	};
+
+	/// <summary>
+	/// z = (a*x + b) / (c*x + d)
+	/// </summary>
+	template<typename int_type>
+	class Homographic : public CFStream<int_type>
+	{
+	public:
+		Homographic(CFStreamPtr<int_type> x, int_type a, int_type b, int_type c, int_type d, unsigned maxIngest = 1000)
+			: x(std::move(x)), a(a), b(b), c(c), d(d), maxIngest(maxIngest)
+		{}
+
+		bool next(int_type &term) override {
+			if (done)
+				return false;
+			for (unsigned ingested = 0;; ingested++) {
+				// the tail of x lies in (1, inf) once its first term is in: bounded by the values at x = inf and x = 0
+				const int_type num[2] = { a, b };
+				const int_type den[2] = { c, d };
+				bool allZero;
+				if (started && detail::commonFloor(num, den, term, allZero)) {
+					emit(term);
+					return true;
+				}
+				if (started && (allZero || (xDone && c == 0 && d == 0))) {
+					done = true;
+					return false;
+				}
+				if (ingested >= maxIngest && started && !xDone) {
+					term = detail::nearestOfInterval(num, den);
+					approx = true;
+					done = true;
+					return true;
+				}
+
+				int_type p;
+				if (!xDone && x->next(p)) {
+					// x = p + 1/x'
+					int_type na, nc;
+					try {
+						na = detail::mulAdd(a, p, b);
+						nc = detail::mulAdd(c, p, d);
+					}
+					catch (const std::overflow_error &) {
+						if (!started)
+							throw;
+						term = detail::nearestOfInterval(num, den);
+						approx = true;
+						done = true;
+						return true;
+					}
+					b = a;
+					d = c;
+					a = na;
+					c = nc;
+				}
+				else if (!xDone) {
+					// x = inf: z = a / c
+					xDone = true;
+					approx = approx || x->approximate();
+					b = a;
+					d = c;
+					a = 0;
+					c = 0;
+				}
+				started = true;
+			}
+		}
+
+		bool approximate() const override { return approx; }
+
+	private:
+		void emit(int_type r) {
+			int_type na = c, nb = d;
+			c = detail::mulSub(a, r, c);
+			d = detail::mulSub(b, r, d);
+			a = na;
+			b = nb;
+		}
+
+		CFStreamPtr<int_type> x;
+		int_type a, b, c, d;
+		unsigned maxIngest;
+		bool started = false;
+		bool xDone = false;
+		bool done = false;
+		bool approx = false;
+	};
+
+	/// <summary>
+	/// z = (a*x*y + b*x + c*y + d) / (e*x*y + f*x + g*y + h)
+	/// </summary>
+	template<typename int_type>
+	class Bihomographic : public CFStream<int_type>
+	{
+	public:
+		Bihomographic(CFStreamPtr<int_type> x, CFStreamPtr<int_type> y,
+			int_type a, int_type b, int_type c, int_type d, int_type e, int_type f, int_type g, int_type h, unsigned maxIngest = 1000)
+			: x(std::move(x)), y(std::move(y)), n{ a, b, c, d }, m{ e, f, g, h }, maxIngest(maxIngest)
+		{}
+
+		bool next(int_type &term) override {
+			if (done)
+				return false;
+			for (unsigned ingested = 0;; ingested++) {
+				bool allZero;
+				if (xStarted && yStarted && detail::commonFloor(n, m, term, allZero)) {
+					emit(term);
+					return true;
+				}
+				if (xDone && yDone) {
+					// z = d / h: the remaining Euclid steps are decided above; h == 0 ends the expansion
+					done = true;
+					return false;
+				}
+				if (ingested >= maxIngest && xStarted && yStarted) {
+					term = detail::nearestOfInterval(n, m);
+					approx = true;
+					done = true;
+					return true;
+				}
+
+				// take from the input whose range (x = 0 vs inf) moves the bounds the most; the other when exhausted
+				bool takeX;
+				if (!xStarted || yDone)
+					takeX = !xDone;
+				else if (!yStarted || xDone)
+					takeX = false;
+				else if (m[0] != 0 && m[1] != 0 && m[2] != 0)
+					takeX = std::abs((long double)n[2] / m[2] - (long double)n[0] / m[0]) > std::abs((long double)n[1] / m[1] - (long double)n[0] / m[0]);
+				else
+					takeX = !(ingested & 1);
+
+				const int_type n0[4] = { n[0], n[1], n[2], n[3] };
+				const int_type m0[4] = { m[0], m[1], m[2], m[3] };
+				try {
+					if (takeX)
+						ingestX();
+					else
+						ingestY();
+				}
+				catch (const std::overflow_error &) {
+					if (!xStarted || !yStarted)
+						throw;
+					term = detail::nearestOfInterval(n0, m0);
+					approx = true;
+					done = true;
+					return true;
+				}
+			}
+		}
+
+		bool approximate() const override { return approx; }
+
+	private:
+		void ingestX() {
+			int_type p;
+			xStarted = true;
+			if (x->next(p)) {
+				// x = p + 1/x':  (a, b, c, d) <- (a p + c, b p + d, a, b)
+				int_type n0 = detail::mulAdd(n[0], p, n[2]), n1 = detail::mulAdd(n[1], p, n[3]);
+				int_type m0 = detail::mulAdd(m[0], p, m[2]), m1 = detail::mulAdd(m[1], p, m[3]);
+				n[2] = n[0]; n[3] = n[1]; n[0] = n0; n[1] = n1;
+				m[2] = m[0]; m[3] = m[1]; m[0] = m0; m[1] = m1;
+			}
+			else {
+				// x = inf: z = (a y + b) / (e y + f)
+				xDone = true;
+				approx = approx || x->approximate();
+				for (int_type *t : { n, m }) {
+					t[2] = t[0];
+					t[3] = t[1];
+					t[0] = 0;
+					t[1] = 0;
+				}
+			}
+		}
+
+		void ingestY() {
+			int_type q;
+			yStarted = true;
+			if (y->next(q)) {
+				// y = q + 1/y':  (a, b, c, d) <- (a q + b, a, c q + d, c)
+				int_type n0 = detail::mulAdd(n[0], q, n[1]), n2 = detail::mulAdd(n[2], q, n[3]);
+				int_type m0 = detail::mulAdd(m[0], q, m[1]), m2 = detail::mulAdd(m[2], q, m[3]);
+				n[1] = n[0]; n[3] = n[2]; n[0] = n0; n[2] = n2;
+				m[1] = m[0]; m[3] = m[2]; m[0] = m0; m[2] = m2;
+			}
+			else {
+				// y = inf: z = (a x + c) / (e x + g)
+				yDone = true;
+				approx = approx || y->approximate();
+				for (int_type *t : { n, m }) {
+					t[1] = t[0];
+					t[3] = t[2];
+					t[0] = 0;
+					t[2] = 0;
+				}
+			}
+		}
+
+		void emit(int_type r) {
+			for (int i = 0; i < 4; i++) {
+				int_type t = detail::mulSub(n[i], r, m[i]);
+				n[i] = m[i];
+				m[i] = t;
+			}
+		}
+
+		CFStreamPtr<int_type> x;
+		CFStreamPtr<int_type> y;
+		int_type n[4];      // a b c d
+		int_type m[4];      // e f g h
+		unsigned maxIngest;
+		bool xStarted = false;
+		bool yStarted = false;
+		bool xDone = false;
+		bool yDone = false;
+		bool done = false;
+		bool approx = false;
+	};
+
+	template<typename int_type>
+	CFStreamPtr<int_type> cfOf(const Fraction<int_type> &frac) {
+			return std::make_unique<FractionCF<int_type>>(frac);
+		}
+
+	/// <summary>
+	/// The expansion of a measured value: the coefficients of toFract(val, Precision).
+	/// </summary>
+	template<typename int_type>
+	CFStreamPtr<int_type> cfOf(double val, double Precision) {
+			return cfOf<int_type>(toFract<int_type>(val, Precision));
+		}
+
+	template<typename int_type>
+	CFStreamPtr<int_type> cfReciprocal(CFStreamPtr<int_type> x) {
+			return std::make_unique<Homographic<int_type>>(std::move(x), 0, 1, 1, 0);
+		}
+
+	template<typename int_type>
+	CFStreamPtr<int_type> cfScale(CFStreamPtr<int_type> x, const Fraction<int_type> &k) {
+			return std::make_unique<Homographic<int_type>>(std::move(x), k.numerator(), 0, 0, k.denominator());
+		}
+
+	template<typename int_type>
+	CFStreamPtr<int_type> cfSum(CFStreamPtr<int_type> x, CFStreamPtr<int_type> y) {
+			return std::make_unique<Bihomographic<int_type>>(std::move(x), std::move(y), 0, 1, 1, 0, 0, 0, 0, 1);
+		}
+
+	template<typename int_type>
+	CFStreamPtr<int_type> cfDifference(CFStreamPtr<int_type> x, CFStreamPtr<int_type> y) {
+			return std::make_unique<Bihomographic<int_type>>(std::move(x), std::move(y), 0, 1, -1, 0, 0, 0, 0, 1);
+		}
+
+	template<typename int_type>
+	CFStreamPtr<int_type> cfProduct(CFStreamPtr<int_type> x, CFStreamPtr<int_type> y) {
+			return std::make_unique<Bihomographic<int_type>>(std::move(x), std::move(y), 1, 0, 0, 0, 0, 0, 0, 1);
+		}
+
+	template<typename int_type>
+	CFStreamPtr<int_type> cfQuotient(CFStreamPtr<int_type> x, CFStreamPtr<int_type> y) {
+			return std::make_unique<Bihomographic<int_type>>(std::move(x), std::move(y), 0, 1, 0, 0, 0, 0, 1, 0);
+		}
+
+	/// <summary>
+	/// <para>Evaluate the convergents of a stream until |value - p/q| &lt; Precision is guaranteed
+	/// (|x - p_n/q_n| &lt;= 1/(q_(n-1) q_n)) or the next convergent would not fit in result_type, and return
+	/// the last convergent. Stream state may use a wider int_type than the result.</para>
+	/// </summary>
+	template<typename result_type, typename int_type>
+	Fraction<result_type> toFraction(CFStream<int_type> &stream, double Precision)
+		{
+			// p_(-1)/q_(-1) = 1/0, p_(-2)/q_(-2) = 0/1
+			result_type p1 = 1, q1 = 0;
+			result_type p0 = 0, q0 = 1;
+			int_type term;
+			bool any = false;
+			while (stream.next(term)) {
+				if (term > int_type(std::numeric_limits<result_type>::max()) || term < int_type(std::numeric_limits<result_type>::min()))
+					break;
+				result_type a = result_type(term);
+				result_type p, q;
+				if (checkedMul(a, p1, p) || checkedAdd(p, p0, p) || checkedMul(a, q1, q) || checkedAdd(q, q0, q))
+					break;
+				p0 = p1; q0 = q1;
+				p1 = p; q1 = q;
+				any = true;
+				if (DebugReporting) {
+					detail::debugReport("CF: term = {}, convergent = {}/{}\n", a, p1, q1);
+				}
+				if (q0 != 0 && 1.0 / (double(q0) * double(q1)) < Precision)
+					break;
+			}
+			if (!any)
+				throw std::invalid_argument("continued fraction stream has no terms");
+			return Fraction<result_type>(p1, q1);
+		}
+
+	template<typename int_type>
+	Fraction<int_type> toFraction(CFStreamPtr<int_type> stream, double Precision)
+		{
+			return toFraction<int_type, int_type>(*stream, Precision);
+		}
+}
@@ -0,0 +1,306 @@
+
+#pragma once
+
+#include "./cf_arithmetic.h"
+#include "./convert_to_fraction.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace cvt_2_fraction
+{
+	/// <summary>
+	/// <para>The convergent matrix of a coefficient run:</para>
+	/// <code>
+	///     | a0 1 |   | a1 1 |       | an 1 |   | p_n  p_(n-1) |
+	///     |  1 0 | * |  1 0 | * ... |  1 0 | = | q_n  q_(n-1) |
+	/// </code>
+	/// <para>
+	/// Matrix products are associative, so a long run can be split anywhere, the pieces multiplied
+	/// independently and the partial products combined in order: the basis of the parallel evaluation
+	/// below. Arithmetic is checked (std::overflow_error) for builtin int_type; with a multiprecision
+	/// int_type (boost::multiprecision::cpp_int) nothing overflows.</para>
+	/// </summary>
+	template<typename int_type>
+	struct CFMatrix
+	{
+		int_type p1 = 1, p0 = 0;
+		int_type q1 = 0, q0 = 1;
+
+		/// <summary>
+		/// this * | a 1 ; 1 0 |: append one coefficient.
+		/// </summary>
+		void append(const int_type &a) {
+				int_type p = detail::mulAdd(a, p1, p0);
+				int_type q = detail::mulAdd(a, q1, q0);
+				p0 = std::move(p1);
+				q0 = std::move(q1);
+				p1 = std::move(p);
+				q1 = std::move(q);
+			}
+
+		CFMatrix operator*(const CFMatrix &b) const {
+				CFMatrix rv;
+				rv.p1 = detail::mulAdd(p1, b.p1, detail::mulAdd(p0, b.q1, int_type(0)));
+				rv.p0 = detail::mulAdd(p1, b.p0, detail::mulAdd(p0, b.q0, int_type(0)));
+				rv.q1 = detail::mulAdd(q1, b.p1, detail::mulAdd(q0, b.q1, int_type(0)));
+				rv.q0 = detail::mulAdd(q1, b.p0, detail::mulAdd(q0, b.q0, int_type(0)));
+				return rv;
+			}
+
+		/// <summary>
+		/// The last convergent p_n / q_n.
+		/// </summary>
+		Fraction<int_type> value() const {
+				return Fraction<int_type>(p1, q1);
+			}
+	};
+
+	namespace detail
+	{
+		template<typename int_type>
+		void checkCoefficients(std::span<const int_type> terms) {
+			if (terms.empty())
+				throw std::invalid_argument("continued fraction without coefficients");
+			for (size_t i = 1; i < terms.size(); i++) {
+				if (terms[i] < 1)
+					throw std::invalid_argument(std::format("continued fraction coefficient a{} is not positive", i));
+			}
+		}
+
+		template<typename int_type>
+		CFMatrix<int_type> productOf(std::span<const int_type> terms) {
+			CFMatrix<int_type> m;
+			for (const int_type &a : terms)
+				m.append(a);
+			return m;
+		}
+
+		inline unsigned workerCount(unsigned workers, size_t terms, size_t minChunk) {
+			if (workers == 0)
+				workers = std::max(1u, std::thread::hardware_concurrency());
+			return unsigned(std::max<size_t>(1, std::min<size_t>(workers, terms / minChunk)));
+		}
+
+		// run fn(i) for i in [0, n) on up to n threads (the calling thread takes i = 0)
+		template<typename Fn>
+		void parallelFor(size_t n, Fn fn) {
+			std::vector<std::thread> threads;
+			std::exception_ptr error;
+			std::mutex lock;
+			for (size_t i = 1; i < n; i++) {
+				threads.emplace_back([&, i] {
+					try {
+						fn(i);
+					}
+					catch (...) {
+						std::lock_guard<std::mutex> guard(lock);
+						error = std::current_exception();
+					}
+				});
+			}
+			try {
+				if (n)
+					fn(0);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> guard(lock);
+				error = std::current_exception();
+			}
+			for (std::thread &t : threads)
+				t.join();
+			if (error)
+				std::rethrow_exception(error);
+		}
+	}
+
+	/// <summary>
+	/// Runs shorter than this are not worth a thread.
+	/// </summary>
+	constexpr size_t CFParallelMinChunk = 4096;
+
+	/// <summary>
+	/// <para>The value of [a0; a1, ..., an] (a1 ... an &gt; 0).</para>
+	///
+	/// <para>
+	/// Long runs are cut into one piece per worker (0: one per hardware thread), the pieces multiplied
+	/// concurrently and the partial products then combined pairwise, again concurrently, in a balanced
+	/// tree: with multiprecision int_type the operands of each round have similar sizes, which suits
+	/// the sub-quadratic multiplication of big-integer libraries.</para>
+	/// </summary>
+	template<typename int_type>
+	Fraction<int_type> fromCoefficients(std::span<const int_type> terms, unsigned workers = 1)
+		{
+			detail::checkCoefficients(terms);
+			unsigned pieces = detail::workerCount(workers, terms.size(), CFParallelMinChunk);
+			if (pieces == 1)
+				return detail::productOf(terms).value();
+
+			std::vector<CFMatrix<int_type>> products(pieces);
+			detail::parallelFor(pieces, [&](size_t i) {
+				size_t first = terms.size() * i / pieces;
+				size_t last = terms.size() * (i + 1) / pieces;
+				products[i] = detail::productOf(terms.subspan(first, last - first));
+			});
+
+			while (products.size() > 1) {
+				std::vector<CFMatrix<int_type>> next((products.size() + 1) / 2);
+				detail::parallelFor(next.size(), [&](size_t i) {
+					next[i] = (2 * i + 1 < products.size()) ? products[2 * i] * products[2 * i + 1] : products[2 * i];
+				});
+				products = std::move(next);
+			}
+			return products.front().value();
+		}
+
+	/// <summary>
+	/// <para>All convergents p_0/q_0 ... p_n/q_n of [a0; a1, ..., an].</para>
+	///
+	/// <para>
+	/// A parallel prefix product: every piece's product is formed concurrently, the (few) piece products
+	/// are scanned in order to give each piece its starting matrix, and the pieces then expand their
+	/// convergents concurrently from there.</para>
+	/// </summary>
+	template<typename int_type>
+	std::vector<Fraction<int_type>> convergentsOf(std::span<const int_type> terms, unsigned workers = 1)
+		{
+			detail::checkCoefficients(terms);
+			unsigned pieces = detail::workerCount(workers, terms.size(), CFParallelMinChunk);
+
+			std::vector<CFMatrix<int_type>> start(pieces);
+			if (pieces > 1) {
+				std::vector<CFMatrix<int_type>> products(pieces);
+				detail::parallelFor(pieces, [&](size_t i) {
+					size_t first = terms.size() * i / pieces;
+					size_t last = terms.size() * (i + 1) / pieces;
+					products[i] = detail::productOf(terms.subspan(first, last - first));
+				});
+				for (size_t i = 1; i < pieces; i++)
+					start[i] = start[i - 1] * products[i - 1];
+			}
+
+			std::vector<Fraction<int_type>> rv(terms.size());
+			detail::parallelFor(pieces, [&](size_t i) {
+				size_t first = terms.size() * i / pieces;
+				size_t last = terms.size() * (i + 1) / pieces;
+				CFMatrix<int_type> m = start[i];
+				for (size_t k = first; k < last; k++) {
+					m.append(terms[k]);
+					rv[k] = m.value();
+				}
+			});
+			return rv;
+		}
+
+	/// <summary>
+	/// <para>Decode many short continued fractions at once: sequence k is
+	/// terms[offsets[k] .. offsets[k + 1]) and its value goes to num[k] / den[k] (lowest terms, den &gt; 0).</para>
+	///
+	/// <para>
+	/// With AVX2 four sequences advance in lockstep, one per 64-bit lane, with 32x32-bit multiplies while
+	/// their convergents stay below 2^32; a lane that outgrows that range (or runs past the others'
+	/// length) is finished by the checked scalar loop, which throws std::overflow_error when a value
+	/// does not fit in int64_t.</para>
+	/// </summary>
+	inline void fromCoefficients(std::span<const int64_t> terms, std::span<const size_t> offsets,
+			std::span<int64_t> num, std::span<int64_t> den)
+		{
+			if (offsets.empty())
+				return;
+			const size_t count = offsets.size() - 1;
+			if (num.size() < count || den.size() < count)
+				throw std::invalid_argument(std::format("fromCoefficients: {} results for {} sequences", std::min(num.size(), den.size()), count));
+			if (offsets.back() > terms.size())
+				throw std::invalid_argument(std::format("fromCoefficients: offset {} is past the {} terms", offsets.back(), terms.size()));
+
+			auto scalar = [&](size_t k) {
+				std::span<const int64_t> seq = terms.subspan(offsets[k], offsets[k + 1] - offsets[k]);
+				detail::checkCoefficients(seq);
+				CFMatrix<int64_t> m = detail::productOf(seq);
+				num[k] = m.p1;
+				den[k] = m.q1;
+			};
+
+			size_t k = 0;
+#if defined(__AVX2__)
+			const __m256i one = _mm256_set1_epi64x(1);
+			const __m256i limit = _mm256_set1_epi64x(0xFFFFFFFFll);
+			// unsigned x > 2^32 - 1, as a signed compare with the sign bits flipped: a * p1 + p0 may reach 2^64 - 2^32
+			const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+			const __m256i biasedLimit = _mm256_xor_si256(limit, sign);
+			auto above = [&](__m256i x) { return _mm256_cmpgt_epi64(_mm256_xor_si256(x, sign), biasedLimit); };
+			for (; k + 4 <= count; k += 4) {
+				size_t len[4], maxLen = 0;
+				for (int j = 0; j < 4; j++) {
+					if (offsets[k + j + 1] < offsets[k + j])
+						throw std::invalid_argument(std::format("fromCoefficients: offsets of sequence {} decrease", k + j));
+					len[j] = offsets[k + j + 1] - offsets[k + j];
+					maxLen = std::max(maxLen, len[j]);
+				}
+				if (std::min({ len[0], len[1], len[2], len[3] }) == 0) {
+					for (int j = 0; j < 4; j++)
+						scalar(k + j);
+					continue;
+				}
+
+				// lanes start after a0 (it may be negative): [0; a1, ...] then p += a0 * q at the end
+				__m256i p1 = _mm256_setzero_si256(), p0 = one;
+				__m256i q1 = one, q0 = _mm256_setzero_si256();
+				__m256i bad = _mm256_setzero_si256();
+				for (size_t i = 1; i < maxLen; i++) {
+					alignas(32) int64_t a[4];
+					alignas(32) int64_t active[4];
+					for (int j = 0; j < 4; j++) {
+						active[j] = (i < len[j]) ? -1 : 0;
+						a[j] = (i < len[j]) ? terms[offsets[k + j] + i] : 0;
+					}
+					__m256i va = _mm256_load_si256(reinterpret_cast<const __m256i *>(a));
+					__m256i mask = _mm256_load_si256(reinterpret_cast<const __m256i *>(active));
+					// coefficients and state must stay below 2^32 for the 32x32 multiplies (a >= 1 is checked afterwards)
+					bad = _mm256_or_si256(bad, _mm256_cmpgt_epi64(va, limit));
+					__m256i p = _mm256_add_epi64(_mm256_mul_epu32(va, p1), p0);
+					__m256i q = _mm256_add_epi64(_mm256_mul_epu32(va, q1), q0);
+					bad = _mm256_or_si256(bad, _mm256_and_si256(mask, _mm256_or_si256(above(p), above(q))));
+					p0 = _mm256_blendv_epi8(p0, p1, mask);
+					q0 = _mm256_blendv_epi8(q0, q1, mask);
+					p1 = _mm256_blendv_epi8(p1, p, mask);
+					q1 = _mm256_blendv_epi8(q1, q, mask);
+				}
+
+				alignas(32) int64_t vp[4], vq[4], vbad[4];
+				_mm256_store_si256(reinterpret_cast<__m256i *>(vp), p1);
+				_mm256_store_si256(reinterpret_cast<__m256i *>(vq), q1);
+				_mm256_store_si256(reinterpret_cast<__m256i *>(vbad), bad);
+				for (int j = 0; j < 4; j++) {
+					const int64_t *seq = terms.data() + offsets[k + j];
+					bool ok = !vbad[j];
+					for (size_t i = 1; ok && i < len[j]; i++)
+						ok = (seq[i] >= 1);
+					int64_t t;
+					if (ok && !checkedMul(seq[0], vq[j], t) && !checkedAdd(t, vp[j], t)) {
+						// p_n = a0 q'_n + p'_n, q_n = q'_n, where p'/q' is the value of [0; a1, ...]
+						num[k + j] = t;
+						den[k + j] = vq[j];
+					}
+					else
+						scalar(k + j);
+				}
+			}
+#endif
+			for (; k < count; k++) {
+				if (offsets[k + 1] < offsets[k])
+					throw std::invalid_argument(std::format("fromCoefficients: offsets of sequence {} decrease", k));
+				scalar(k);
+			}
+		}
+}
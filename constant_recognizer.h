@@ -0,0 +1,145 @@
+
+#pragma once
+
+#include "./convert_to_fraction.h"
+
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace cvt_2_fraction
+{
+	struct NamedConstant
+	{
+		std::string name;
+		double value;
+	};
+
+	struct RecognizedConstant
+	{
+		Fraction<int64_t> multiple;     // val ~= multiple * constant
+		size_t constant;                // index into ConstantRecognizer::constants()
+		double error;                   // |val - multiple * constant| / |val|
+	};
+
+	/// <summary>
+	/// <para>Recognizes doubles that are small rational multiples (p/q) C of known constants: 3 pi / 4,
+	/// sqrt(2) / 2, -2 ln 2, ... (and plain fractions, with the constant 1). Values like these stored as
+	/// plain fractions need huge terms and lose their meaning.</para>
+	///
+	/// <para>
+	/// Every constant is kept as its reciprocal, so a candidate costs one multiplication x = val / C and
+	/// one toFract() descent on x, which stops at the first Stern-Brocot node within the precision, so
+	/// the fraction found is a small one. The descent is capped at maxDenominator: for a constant val
+	/// is no small multiple of it gives up there, rather than descending towards huge terms. A candidate
+	/// is accepted when |p| &lt;= maxNumerator, q &lt;= maxDenominator and |val - (p/q) C| &lt;= tolerance |val|;
+	/// of the accepted ones the smallest max(|p|, q) wins, then the earlier constant.</para>
+	/// </summary>
+	class ConstantRecognizer
+	{
+	public:
+		/// <summary>
+		/// 1, pi, e, ln 2 and the square roots of 2, 3 and 5.
+		/// </summary>
+		static std::vector<NamedConstant> defaultConstants() {
+				return {
+					{ "1", 1.0 },
+					{ "pi", std::numbers::pi_v<double> },
+					{ "e", std::numbers::e_v<double> },
+					{ "ln2", std::numbers::ln2_v<double> },
+					squareRoot(2),
+					squareRoot(3),
+					squareRoot(5),
+				};
+			}
+
+		static NamedConstant squareRoot(int k) {
+				if (k < 2)
+					throw std::invalid_argument(std::format("ConstantRecognizer: sqrt({}) is not a useful constant", k));
+				return { std::format("sqrt({})", k), std::sqrt(double(k)) };
+			}
+
+		explicit ConstantRecognizer(std::vector<NamedConstant> constants = defaultConstants(), double tolerance = 1E-12,
+				int64_t maxDenominator = 1000, int64_t maxNumerator = 1000000)
+			: table(std::move(constants)), tolerance(tolerance), maxDenominator(maxDenominator), maxNumerator(maxNumerator)
+			{
+				if (table.empty())
+					throw std::invalid_argument("ConstantRecognizer: no constants given");
+				if (!(tolerance > 0 && tolerance < 1))
+					throw std::invalid_argument(std::format("ConstantRecognizer: invalid tolerance {}", tolerance));
+				if (maxDenominator < 1 || maxNumerator < 1)
+					throw std::invalid_argument("ConstantRecognizer: the bounds must be positive");
+				for (const NamedConstant &c : table) {
+					if (!(std::isfinite(c.value) && c.value > 0))
+						throw std::invalid_argument(std::format("ConstantRecognizer: invalid constant {} = {}", c.name, c.value));
+					reciprocals.push_back(1.0 / c.value);
+				}
+			}
+
+		const std::vector<NamedConstant> &constants() const { return table; }
+
+		/// <summary>
+		/// The simplest multiple of a constant val is, if any.
+		/// </summary>
+		std::optional<RecognizedConstant> recognize(double val) const {
+				if (!std::isfinite(val))
+					return std::nullopt;
+				if (val == 0)
+					return RecognizedConstant{ Fraction<int64_t>(0), 0, 0.0 };
+
+				std::optional<RecognizedConstant> best;
+				int64_t bestHeight = 0;
+				for (size_t i = 0; i < table.size(); i++) {
+					const double x = val * reciprocals[i];
+					if (!(std::abs(x) < double(maxNumerator) + 1))
+						continue;
+					// toFract() tests |q x - p| against its precision; relative to x, as the tolerance is
+					Fraction<int64_t> f = toFract<int64_t>(x, tolerance * std::abs(x), nullptr, maxDenominator);
+					const int64_t height = std::max(std::abs(f.numerator()), f.denominator());
+					if (f.denominator() > maxDenominator || std::abs(f.numerator()) > maxNumerator || f.numerator() == 0)
+						continue;
+					const double error = std::abs(val - toFloat(f) * table[i].value) / std::abs(val);
+					if (error > tolerance)
+						continue;
+					if (!best || height < bestHeight) {
+						best = RecognizedConstant{ f, i, error };
+						bestHeight = height;
+					}
+				}
+				return best;
+			}
+
+		/// <summary>
+		/// recognize() for a batch of values.
+		/// </summary>
+		void recognize(std::span<const double> values, std::span<std::optional<RecognizedConstant>> out) const {
+				if (out.size() < values.size())
+					throw std::invalid_argument(std::format("ConstantRecognizer: {} results for {} values", out.size(), values.size()));
+				for (size_t i = 0; i < values.size(); i++)
+					out[i] = recognize(values[i]);
+			}
+
+		/// <summary>
+		/// "3/4*pi", "-2*ln2", "1/10" (the constant 1 is left out).
+		/// </summary>
+		std::string toString(const RecognizedConstant &r) const {
+				const std::string &name = table.at(r.constant).name;
+				std::string multiple = (r.multiple.denominator() == 1 ? std::format("{}", r.multiple.numerator()) : cvt_2_fraction::toString(r.multiple));
+				if (name == "1" || r.multiple.numerator() == 0)
+					return multiple;
+				return multiple + "*" + name;
+			}
+
+	private:
+		std::vector<NamedConstant> table;
+		std::vector<double> reciprocals;
+		double tolerance;
+		int64_t maxDenominator;
+		int64_t maxNumerator;
+	};
+}
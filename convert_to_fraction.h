@@ -2,16 +2,37 @@
 #pragma once
 
 #include <boost/rational.hpp>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
 #include <limits>
+#include <cmath>
+#include <type_traits>
 #include <numbers>
 #include <exception>
 #include <format>
 #include <iostream>
+#include <iterator>
 #include <cassert>
+#include <utility>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "./fraction_trace.h"
+
+// Define as 0 to compile out the diagnostic output of the conversion code (benchmarks, production builds).
+#if !defined(CVT2FRAC_DEBUG_REPORTING)
+#define CVT2FRAC_DEBUG_REPORTING 1
+#endif
+
+// Define to use the portable multiword arithmetic of the exact comparisons even where the compiler has
+// __int128 (that is how the fallback gets tested on GNU toolchains).
+// #define CVT2FRAC_PORTABLE_WIDE
 
 namespace cvt_2_fraction
 {
-	constexpr bool DebugReporting = true;
+	constexpr bool DebugReporting = CVT2FRAC_DEBUG_REPORTING;
 
 	template<typename int_type>
 	using Fraction = boost::rational::rational<int_type>;
@@ -26,6 +47,65 @@ namespace cvt_2_fraction
 			return std::format("{}/{}", frac.numerator(), frac.denominator());
 		}
 
+	namespace detail
+	{
+		// mutes the DebugReporting output of the calling thread at run time (bulk conversion workers)
+		inline bool &debugMuted() {
+			thread_local bool muted = false;
+			return muted;
+		}
+
+		// DebugReporting output, formatted straight into std::cerr's stream buffer: no temporary std::string
+		// is built, so the diagnostics keep the conversion free of heap allocations.
+		template<typename... Args>
+		void debugReport(std::format_string<Args...> fmt, Args &&...args) {
+			if (debugMuted())
+				return;
+			std::format_to(std::ostreambuf_iterator<char>(std::cerr), fmt, std::forward<Args>(args)...);
+		}
+	}
+
+	/// <summary>
+	/// Overflow checked integer arithmetic: returns true when the exact result did not fit in int_type
+	/// (the value stored in `result` is unspecified then). Unbounded (multiprecision) types never overflow.
+	/// </summary>
+	template<typename int_type>
+	bool checkedMul(int_type a, int_type b, int_type &result) {
+#if defined(__GNUC__) || defined(__clang__)
+			if constexpr (std::is_integral_v<int_type>)
+				return __builtin_mul_overflow(a, b, &result);
+#endif
+			if constexpr (std::numeric_limits<int_type>::is_bounded) {
+				constexpr int_type MaxValue{std::numeric_limits<int_type>::max()};
+				constexpr int_type MinValue{std::numeric_limits<int_type>::min()};
+				if (a != 0 && b != 0) {
+					bool overflow = (a > 0)
+						? (b > 0 ? a > MaxValue / b : b < MinValue / a)
+						: (b > 0 ? a < MinValue / b : a < MaxValue / b);
+					if (overflow)
+						return true;
+				}
+			}
+			result = a * b;
+			return false;
+		}
+
+	template<typename int_type>
+	bool checkedAdd(int_type a, int_type b, int_type &result) {
+#if defined(__GNUC__) || defined(__clang__)
+			if constexpr (std::is_integral_v<int_type>)
+				return __builtin_add_overflow(a, b, &result);
+#endif
+			if constexpr (std::numeric_limits<int_type>::is_bounded) {
+				constexpr int_type MaxValue{std::numeric_limits<int_type>::max()};
+				constexpr int_type MinValue{std::numeric_limits<int_type>::min()};
+				if ((b > 0 && a > MaxValue - b) || (b < 0 && a < MinValue - b))
+					return true;
+			}
+			result = a + b;
+			return false;
+		}
+
 
 
     /// <summary>
@@ -244,8 +324,378 @@ namespace cvt_2_fraction
     /// </para>
     /// </summary>
 
+	namespace detail
+	{
+		/// <summary>
+		/// a * b as two 64-bit words: returns the low word, the high word goes to `hi`.
+		/// </summary>
+		inline uint64_t mulWide(uint64_t a, uint64_t b, uint64_t &hi) {
+#if defined(__SIZEOF_INT128__) && !defined(CVT2FRAC_PORTABLE_WIDE)
+			const unsigned __int128 p = (unsigned __int128)a * b;
+			hi = uint64_t(p >> 64);
+			return uint64_t(p);
+#elif defined(_MSC_VER) && defined(_M_X64) && !defined(CVT2FRAC_PORTABLE_WIDE)
+			return _umul128(a, b, &hi);
+#else
+			const uint64_t a0 = uint32_t(a), a1 = a >> 32, b0 = uint32_t(b), b1 = b >> 32;
+			const uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+			const uint64_t mid = (p00 >> 32) + uint32_t(p01) + uint32_t(p10);
+			hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+			return (mid << 32) | uint32_t(p00);
+#endif
+		}
+
+		/// <summary>
+		/// <para>Two's complement integer of Words 64-bit words, built on mulWide(): the wide products of the
+		/// exact comparisons where the compiler has no builtin type wide enough. Arithmetic wraps around
+		/// like that of unsigned types; shift counts must be below the width.</para>
+		/// </summary>
+		template<size_t Words>
+		struct WideInt
+		{
+			uint64_t w[Words] = {};     // least significant first
+
+			WideInt() = default;
+			WideInt(int64_t v) {
+				w[0] = uint64_t(v);
+				for (size_t i = 1; i < Words; i++)
+					w[i] = (v < 0 ? ~uint64_t(0) : 0);
+			}
+
+			bool negative() const { return (w[Words - 1] >> 63) != 0; }
+
+			// correctly rounded: the top 64 bits, with a sticky bit for everything below them
+			explicit operator double() const {
+				if (negative()) {
+					const WideInt magnitude = -*this;
+					return magnitude.negative() ? -std::ldexp(1.0, int(64 * Words - 1)) : -double(magnitude);
+				}
+				size_t top = Words;
+				while (top > 0 && w[top - 1] == 0)
+					top--;
+				if (top <= 1)
+					return double(w[0]);
+				const int shift = int(64 * (top - 1)) - std::countl_zero(w[top - 1]);
+				const WideInt window = *this >> shift;
+				uint64_t sticky = 0;
+				for (size_t i = 0; i < size_t(shift / 64); i++)
+					sticky |= w[i];
+				if (shift % 64 != 0)
+					sticky |= w[shift / 64] << (64 - shift % 64);
+				return std::ldexp(double(window.w[0] | (sticky != 0)), shift);
+			}
+
+			// the low 64 bits, as a builtin conversion would wrap them
+			explicit operator int64_t() const { return int64_t(w[0]); }
+
+			friend WideInt operator-(const WideInt &a) {
+				WideInt r;
+				uint64_t carry = 1;
+				for (size_t i = 0; i < Words; i++) {
+					r.w[i] = ~a.w[i] + carry;
+					carry = (r.w[i] < carry);
+				}
+				return r;
+			}
+
+			friend WideInt operator+(const WideInt &a, const WideInt &b) {
+				WideInt r;
+				uint64_t carry = 0;
+				for (size_t i = 0; i < Words; i++) {
+					const uint64_t s = a.w[i] + carry;
+					carry = (s < carry);
+					r.w[i] = s + b.w[i];
+					carry += (r.w[i] < s);
+				}
+				return r;
+			}
+
+			friend WideInt operator-(const WideInt &a, const WideInt &b) { return a + -b; }
+
+			// schoolbook, truncated to Words words: two's complement needs no sign handling
+			friend WideInt operator*(const WideInt &a, const WideInt &b) {
+				WideInt r;
+				for (size_t i = 0; i < Words; i++) {
+					uint64_t carry = 0;
+					for (size_t j = 0; i + j < Words; j++) {
+						uint64_t hi, lo = mulWide(a.w[i], b.w[j], hi);
+						lo += carry;
+						hi += (lo < carry);
+						r.w[i + j] += lo;
+						hi += (r.w[i + j] < lo);
+						carry = hi;
+					}
+				}
+				return r;
+			}
+
+			friend WideInt operator<<(const WideInt &a, int s) {
+				WideInt r;
+				const size_t k = size_t(s) / 64;
+				const int b = s % 64;
+				for (size_t i = Words; i-- > k;) {
+					r.w[i] = a.w[i - k] << b;
+					if (b != 0 && i > k)
+						r.w[i] |= a.w[i - k - 1] >> (64 - b);
+				}
+				return r;
+			}
+
+			// arithmetic: rounds towards minus infinity
+			friend WideInt operator>>(const WideInt &a, int s) {
+				WideInt r;
+				const uint64_t fill = (a.negative() ? ~uint64_t(0) : 0);
+				const size_t k = size_t(s) / 64;
+				const int b = s % 64;
+				for (size_t i = 0; i < Words; i++) {
+					const uint64_t lo = (i + k < Words ? a.w[i + k] : fill);
+					const uint64_t hi = (i + k + 1 < Words ? a.w[i + k + 1] : fill);
+					r.w[i] = (b == 0 ? lo : (lo >> b) | (hi << (64 - b)));
+				}
+				return r;
+			}
+
+			friend bool operator==(const WideInt &a, const WideInt &b) {
+				for (size_t i = 0; i < Words; i++) {
+					if (a.w[i] != b.w[i])
+						return false;
+				}
+				return true;
+			}
+
+			friend bool operator<(const WideInt &a, const WideInt &b) {
+				if (a.negative() != b.negative())
+					return a.negative();
+				for (size_t i = Words; i-- > 0;) {
+					if (a.w[i] != b.w[i])
+						return a.w[i] < b.w[i];
+				}
+				return false;
+			}
+
+			friend bool operator>(const WideInt &a, const WideInt &b) { return b < a; }
+			friend bool operator<=(const WideInt &a, const WideInt &b) { return !(b < a); }
+			friend bool operator>=(const WideInt &a, const WideInt &b) { return !(a < b); }
+		};
+
+		/// <summary>
+		/// n / d for n taken as unsigned and 0 &lt; d &lt; 2^63, one quotient bit at a time; the remainder goes
+		/// to `rem`. Meant for set-up code (magic reciprocals), not for loops.
+		/// </summary>
+		template<size_t Words>
+		WideInt<Words> divMod(const WideInt<Words> &n, uint64_t d, uint64_t &rem) {
+			WideInt<Words> q;
+			rem = 0;
+			for (size_t i = 64 * Words; i-- > 0;) {
+				rem = (rem << 1) | ((n.w[i / 64] >> (i % 64)) & 1);
+				if (rem >= d) {
+					rem -= d;
+					q.w[i / 64] |= uint64_t(1) << (i % 64);
+				}
+			}
+			return q;
+		}
+
+		// 128-bit signed arithmetic: the builtin type where there is one
+#if defined(__SIZEOF_INT128__) && !defined(CVT2FRAC_PORTABLE_WIDE)
+		using Int128 = __int128;
+#else
+		using Int128 = WideInt<2>;
+#endif
+
+		template<typename wide_type>
+		int signOf(const wide_type &v) {
+			return (v > 0) - (v < 0);
+		}
+
+		/// <summary>
+		/// sign(p - L * 2^e), exact, for |p|, |L| &lt; 2^(Bits - 2) in the Bits wide wide_type.
+		/// </summary>
+		template<int Bits, typename wide_type>
+		int compareScaled(const wide_type &p, const wide_type &L, int e) {
+			if (L == 0)
+				return signOf(p);
+			if (e >= 0) {
+				const wide_type absL = (L < 0 ? -L : L);
+				if (e > Bits - 2 || absL > (wide_type(1) << (Bits - 2 - e)))
+					return -signOf(L);                      // |L * 2^e| > 2^(Bits - 2) > |p|
+				return signOf(p - L * (wide_type(1) << e));
+			}
+			if (-e >= Bits - 1)
+				return p != 0 ? signOf(p) : -signOf(L);     // 0 < |L * 2^e| < 1
+
+			// f = floor(L * 2^e), L * 2^e = f + rem / 2^-e with 0 <= rem < 2^-e
+			const wide_type f = L >> -e;
+			if (f != p)
+				return f < p ? 1 : -1;
+			return (L - (f << -e)) != 0 ? -1 : 0;
+		}
+
+		/// <summary>
+		/// x as the dyadic rational m * 2^e it represents, |m| &lt; 2^53.
+		/// </summary>
+		inline int64_t splitDyadic(double x, int &e) {
+			int exp;
+			double mant = std::frexp(x, &exp);
+			e = exp - 53;
+			return int64_t(std::ldexp(mant, 53));
+		}
+
+		/// <summary>
+		/// sign(p / q - x) for q &gt; 0, exact: x is taken as the dyadic rational m * 2^e it represents.
+		/// </summary>
+		inline int compareExact(int64_t p, int64_t q, double x) {
+			if (std::isinf(x))
+				return x > 0 ? -1 : 1;
+
+			// sign(p - x * q), with L = m * q and x * q = L * 2^e
+			int e;
+			const int64_t m = splitDyadic(x, e);
+			return compareScaled<128>(Int128(p), Int128(m) * q, e);   // |L| < 2^116
+		}
+
+		/// <summary>
+		/// q * x - p, rounded from its exact value (twice at most): x = m * 2^e is split into the integer and
+		/// fraction parts of L * 2^e, L = m * q, so nothing cancels in floating point.
+		/// </summary>
+		inline double residualExact(int64_t p, int64_t q, double x) {
+			int e;
+			const int64_t m = splitDyadic(x, e);
+			if (e >= 0 || -e >= 127)
+				return double((long double)q * x - (long double)p);
+
+			const Int128 L = Int128(m) * q;                 // |L| < 2^116
+			const Int128 f = L >> -e;
+			const Int128 rem = L - (f << -e);               // 0 <= rem < 2^-e
+			const Int128 d = f - p;
+			// round the fraction on the side of zero it ends up on: 2^-e - 1 must not round up to 1
+			if (d < 0 && rem != 0)
+				return double(d + 1) - std::ldexp(double((Int128(1) << -e) - rem), e);
+			return double(d) + std::ldexp(double(rem), e);
+		}
+
+		/// <summary>
+		/// den * val - num, the residual the descent tests against Precision. A single fma() rounds it
+		/// once while both values are below 2^53; beyond that (int64_t at extreme precisions) it is
+		/// formed by residualExact(), as double products of such values are no longer exact.
+		/// </summary>
+		template<typename int_type>
+		double residual(const int_type &num, const int_type &den, double val) {
+			if constexpr (std::is_integral_v<int_type> && sizeof(int_type) <= sizeof(int64_t)) {
+				constexpr int64_t Exact = int64_t(1) << 53;
+				if (!(num <= Exact && num >= -Exact && den <= Exact))
+					return residualExact(int64_t(num), int64_t(den), val);
+			}
+			return std::fma(double(den), val, -double(num));
+		}
+
+		// den * val - num from plain double products, for values past 2^53, and a bound on its error:
+		// den, num and the product are each rounded once (2^-53 relative), the difference once more
+		inline double plainResidual(int64_t num, int64_t den, double val, double &bound) {
+			const double n = double(num), p = double(den) * val;
+			const double r = p - n;
+			bound = (std::abs(p) + std::abs(n) + std::abs(r)) * 0x1p-51;
+			return r;
+		}
+
+		/// <summary>
+		/// <para>residual() as the descent uses it: compared with `limit` (+-Precision) and divided into the
+		/// step ratio. Past 2^53, where residual() takes the 128-bit residualExact(), the plain double
+		/// residual is tried first: when it lies clear of limit by more than its error bound, and the bound
+		/// is small next to it (the ratio keeps 30 bits), it decides like the exact residual would. The
+		/// exact residual is only formed near the Precision boundary, or once the plain one has cancelled.</para>
+		/// </summary>
+		template<typename int_type>
+		double descentResidual(const int_type &num, const int_type &den, double val, double limit) {
+			if constexpr (std::is_integral_v<int_type> && sizeof(int_type) <= sizeof(int64_t)) {
+				constexpr int64_t Exact = int64_t(1) << 53;
+				if (!(num <= Exact && num >= -Exact && den <= Exact)) {
+					double bound;
+					const double r = plainResidual(int64_t(num), int64_t(den), val, bound);
+					if (std::abs(r - limit) > 2 * bound && bound <= std::abs(r) * 0x1p-30)
+						return r;
+				}
+			}
+			return residual(num, den, val);
+		}
+
+		/// <summary>
+		/// sign(num / den - val) for den &gt; 0. Exact for builtin int_type up to 64 bits: with both values
+		/// below 2^53 a single fma() gives the correctly rounded, hence correctly signed, residual;
+		/// beyond that the plain residual decides when it is clear of its error bound, and compareExact()
+		/// otherwise. Wider types get the fma() estimate.
+		/// </summary>
+		template<typename int_type>
+		int sideOf(const int_type &num, const int_type &den, double val) {
+			if constexpr (std::is_integral_v<int_type> && sizeof(int_type) <= sizeof(int64_t)) {
+				constexpr int64_t Exact = int64_t(1) << 53;
+				if (!(num <= Exact && num >= -Exact && den <= Exact)) {
+					double bound;
+					const double r = plainResidual(int64_t(num), int64_t(den), val, bound);
+					if (std::abs(r) > bound)
+						return (r < 0) - (r > 0);
+					return compareExact(int64_t(num), int64_t(den), val);
+				}
+			}
+			double r = std::fma(-double(den), val, double(num));
+			return (r > 0) - (r < 0);
+		}
+
+		/// <summary>
+		/// A Stern-Brocot node num/den as the toFract() descent holds it: the terms of a mediant are coprime
+		/// by construction, so unlike a Fraction (which reduces by a gcd on every assignment) it is taken
+		/// as is. The gcd was the larger part of the cost of a descent step.
+		/// </summary>
+		template<typename int_type>
+		struct SternBrocotNode
+		{
+			int_type num;
+			int_type den;
+
+			const int_type &numerator() const { return num; }
+			const int_type &denominator() const { return den; }
+		};
+
+		template<typename int_type, typename node_type>
+		void traceRecord(trace::Ring *tracer, uint32_t conversion, uint16_t iteration, trace::Kind kind, uint8_t flags,
+			double testLow, double testHigh, double x1, double x2, int_type n, const node_type &low, const node_type &high)
+			{
+				tracer->push(trace::Record{ conversion, 0, iteration, kind, flags, {}, testLow, testHigh, x1, x2, int64_t(n),
+					int64_t(low.numerator()), int64_t(low.denominator()), int64_t(high.numerator()), int64_t(high.denominator()) });
+			}
+	}
+
+	/// <summary>
+	/// The Stern-Brocot interval the toFract() descent ended in: low &lt;= val &lt;= high, and the answer is
+	/// one of the two ends.
+	/// </summary>
+	template<typename int_type>
+	struct FractionBracket
+	{
+		Fraction<int_type> low;
+		Fraction<int_type> high;
+	};
+
+	/// <summary>
+	/// The descent with a denominator cap: it stops before any denominator exceeds maxDenominator, and
+	/// when no fraction within Precision is found below it, answers with the closer end of the bracket
+	/// reached (as when the range of int_type runs out). Searches that reject large denominators anyway
+	/// are spared the deep descent towards them.
+	/// </summary>
+	template<typename int_type>
+	Fraction<int_type> toFract(double val, double Precision, FractionBracket<int_type> *bracket, int_type maxDenominator);
+
+	template<typename int_type>
+	Fraction<int_type> toFract(double val, double Precision, FractionBracket<int_type> *bracket)
+		{
+			return toFract<int_type>(val, Precision, bracket, std::numeric_limits<int_type>::max());
+		}
+
 	template<typename int_type>
-	Fraction<int_type> toFract(double val, double Precision);
+	Fraction<int_type> toFract(double val, double Precision)
+		{
+			return toFract<int_type>(val, Precision, nullptr);
+		}
 
 	template<typename int_type>
 	Fraction<int_type> toFract(float val)
@@ -260,44 +710,141 @@ namespace cvt_2_fraction
         }
 
 	template<typename int_type>
-	Fraction<int_type> toFract(double val, double Precision)
+	Fraction<int_type> toFract(double val, double Precision, FractionBracket<int_type> *bracket, int_type maxDenominator)
 		{
 			constexpr int_type MaxValue{std::numeric_limits<int_type>::max()};
 
 			if (DebugReporting) {
-				std::cerr << std::format("Fraction: val = {}, precision = {}\n", val, Precision);
+				detail::debugReport("Fraction: val = {}, precision = {}\n", val, Precision);
 			}
 
 			// find nearest fraction
-			int_type intPart = int_type(val);
-			val -= double(intPart);
-			if (std::abs(val) > 1)
+			if (!(std::abs(val) < double(MaxValue)))
 			{
 				throw std::invalid_argument(std::format("fraction cannot be larger than +/-{}.", MaxValue));
 			}
+			if (maxDenominator < 1)
+			{
+				throw std::invalid_argument(std::format("invalid denominator cap {}.", maxDenominator));
+			}
+			// The descent needs a fraction part in [0, 1), and val - floor(val) is not exact for negative val
+			// (-1E-30 would become 1 - 1E-30 == 1). The Stern-Brocot path of -val mirrors that of val, so
+			// negative values are converted through their magnitude instead.
+			if (val < 0)
+			{
+				Fraction<int_type> rv = toFract<int_type>(-val, Precision, bracket, maxDenominator);
+				if (bracket)
+					*bracket = FractionBracket<int_type>{ -bracket->high, -bracket->low };
+				return -rv;
+			}
+			int_type intPart = int_type(val);
+			val -= double(intPart);
 
-			Fraction<int_type> low(int_type(0), int_type(1));           // "A" = 0/1 (a/b)
-			Fraction<int_type> high(int_type(1), int_type(1));          // "B" = 1/1 (c/d)
+			using Node = detail::SternBrocotNode<int_type>;
+			Node low{ int_type(0), int_type(1) };               // "A" = 0/1 (a/b)
+			Node high{ int_type(1), int_type(1) };              // "B" = 1/1 (c/d)
 
 			if (DebugReporting) {
-				std::cerr << std::format("Fraction: val = {}, precision = {}, intpart = {}\n", val, Precision, intPart);
+				detail::debugReport("Fraction: val = {}, precision = {}, intpart = {}\n", val, Precision, intPart);
 			}
 
+			// binary tracing: the switch is sampled once per conversion
+			trace::Ring *tracer = trace::enabled() ? &trace::localRing() : nullptr;
+			uint32_t traceConversion = tracer ? tracer->nextConversion() : 0;
+			uint16_t traceIteration = 0;
+			if (tracer) {
+				detail::traceRecord<int_type>(tracer, traceConversion, 0, trace::Kind::Begin, 0, val, Precision, 0, 0, intPart, low, high);
+			}
+
+			// base + k * dir, exactly: false when it, or its numerator once intPart is added back, overflows,
+			// or its denominator exceeds the cap
+			auto step = [intPart, maxDenominator](const Node &base, const Node &dir, int_type k, int_type &num, int_type &den) {
+				int_type t;
+				if (checkedMul(k, dir.numerator(), t) || checkedAdd(t, base.numerator(), num))
+					return false;
+				if (checkedMul(k, dir.denominator(), t) || checkedAdd(t, base.denominator(), den) || den > maxDenominator)
+					return false;
+				return !checkedMul(intPart, den, t) && !checkedAdd(t, num, t);
+			};
+
+			// the whole part of a step ratio, kept below MaxValue so that n + 1 can be formed
+			auto stepCount = [](double x) {
+				return (x >= double(MaxValue) - 1) ? int_type(MaxValue - 1) : int_type(x);
+			};
+
+			// base + k * dir as tested by settle(): whether it fits, and its terms if it does
+			struct Probe
+			{
+				int_type k;
+				bool fits;
+				int_type num, den;
+			};
+
+			// The step ratio is a quotient of two rounded residuals, so its whole part n may be off by one
+			// (more when it is huge). Settle it exactly: the largest k for which base + k * dir still lies
+			// on base's side of val (want = +1: at or above val, -1: at or below) and fits in int_type.
+			// Galloping from the estimate costs two side tests when it was right. The last k that failed
+			// is left in `miss`: that is k = n + 1, the step the descent takes next.
+			auto settle = [&step, val](const Node &base, const Node &dir, int want, int_type n, Probe &miss) {
+				auto holds = [&](int_type k) {
+					int_type num{}, den{};
+					const bool fits = step(base, dir, k, num, den);
+					if (fits && want * detail::sideOf(num, den, val) >= 0)
+						return true;
+					miss = Probe{ k, fits, num, den };
+					return false;
+				};
+				int_type lo, hi;                // holds(lo), !holds(hi)
+				int_type d = 1;
+				if (holds(n)) {
+					lo = n;
+					for (;;) {
+						hi = (lo >= MaxValue - d) ? MaxValue : int_type(lo + d);
+						if (hi == MaxValue || !holds(hi))
+							break;
+						lo = hi;
+						d = (d > MaxValue / 2) ? MaxValue : int_type(2 * d);
+					}
+					if (hi == MaxValue && holds(hi))
+						return hi;
+				}
+				else {
+					hi = n;
+					for (;;) {
+						lo = (hi <= d) ? int_type(0) : int_type(hi - d);
+						if (lo == 0 || holds(lo))
+							break;      // k = 0 (base itself) always holds
+						hi = lo;
+						d = (d > MaxValue / 2) ? MaxValue : int_type(2 * d);
+					}
+				}
+				while (hi - lo > 1) {
+					int_type mid = lo + (hi - lo) / 2;
+					if (holds(mid))
+						lo = mid;
+					else
+						hi = mid;
+				}
+				return lo;
+			};
+
+			bool overflowed = false;
 			for (;;)
 			{
-				assert(toFloat<int_type>(low) <= val);
-				assert(toFloat<int_type>(high) >= val);
+				assert(detail::sideOf(low.numerator(), low.denominator(), val) <= 0);
+				assert(detail::sideOf(high.numerator(), high.denominator(), val) >= 0);
 
 				//         b*m - a
 				//     x = -------
 				//         c - d*m
-				double testLow = low.denominator() * val - low.numerator();
-				double testHigh = high.numerator() - high.denominator() * val;
+				// the residuals, exact enough for the Precision test and the step ratio
+				double testLow = detail::descentResidual(low.num, low.den, val, Precision);
+				double testHigh = -detail::descentResidual(high.num, high.den, val, -Precision);
 
 				if (DebugReporting)
 				{
-					std::cerr << std::format("Fraction: testlow = {} (fraction: {}), testhigh = {} (fraction: {})\n",
-							testLow, low, testHigh, high);
+					detail::debugReport("Fraction: testlow = {} (fraction: {}/{}), testhigh = {} (fraction: {}/{})\n",
+							testLow, low.num, low.den, testHigh, high.num, high.den);
 				}
 
 				// test for match:
@@ -312,13 +859,19 @@ namespace cvt_2_fraction
 				//if (testHigh < high.denominator() * Precision)
 				if (testHigh < Precision) // [i_a] speed improvement; this is even better for irrational 'val'
 				{
+					if (tracer) {
+						detail::traceRecord<int_type>(tracer, traceConversion, traceIteration, trace::Kind::Iteration, trace::MatchHigh, testLow, testHigh, 0, 0, 0, low, high);
+					}
 					break; // high is answer
 				}
 				//if (testLow < low.denominator() * Precision)
 				if (testLow < Precision) // [i_a] speed improvement; this is even better for irrational 'val'
 				{
-					// low is answer
-					high = low;
+					if (tracer) {
+						detail::traceRecord<int_type>(tracer, traceConversion, traceIteration, trace::Kind::Iteration, trace::MatchLow, testLow, testHigh, 0, 0, 0, low, high);
+					}
+					// low is answer; keep the other end for the bracket
+					std::swap(low, high);
 					break;
 				}
 
@@ -326,82 +879,140 @@ namespace cvt_2_fraction
 				double x2 = testLow / testHigh;
 
 				if (DebugReporting) {
-					std::cerr << std::format("Fraction: x1 = {}, x2 = {}, fraction = {}\n", x1, x2, high);
+					detail::debugReport("Fraction: x1 = {}, x2 = {}, fraction = {}/{}\n", x1, x2, high.num, high.den);
 				}
 
 				// always choose the path where we find the largest change in direction:
 				if (x1 > x2)
 				{
 					//double x1 = testHigh / testLow;
+					Probe next{};
+					int_type n = settle(high, low, +1, stepCount(x1), next);    // lower bound for m
+
+					//     a + x*c
+					//     ------- = m
+					//     b + x*d
+					//int_type l_num = m * low.numerator() + high.numerator();
+					//int_type l_denom = m * low.denominator() + high.denominator();
+					if (next.k != n + 1) {
+						next.k = n + 1;
+						next.fits = step(high, low, n + 1, next.num, next.den);
+					}
+					int_type l_num = next.num, l_denom = next.den;
+
 					// safety checks: are we going to be out of integer bounds?
-					if ((x1 + 1) * low.denominator() + high.denominator() >= double(MaxValue))
+					// (settle() has made sure the n end fits)
+					if (!next.fits)
 					{
+						// the best semiconvergent high + n * low that fits replaces high
+						if (tracer) {
+							detail::traceRecord<int_type>(tracer, traceConversion, traceIteration, trace::Kind::Iteration, trace::StepLow | trace::Overflow, testLow, testHigh, x1, x2, n, low, high);
+						}
+						if (n > 0)
+							high = Node{ int_type(high.num + n * low.num), int_type(high.den + n * low.den) };
+						overflowed = true;
 						break;
 					}
 
-					int_type n = int_type(x1);    // lower bound for m
+					if (tracer) {
+						detail::traceRecord<int_type>(tracer, traceConversion, traceIteration, trace::Kind::Iteration, trace::StepLow, testLow, testHigh, x1, x2, n, low, high);
+					}
 					//int m = n + 1;    // upper bound for m
 
-					//     a + x*c
-					//     ------- = m
-					//     b + x*d
-					int_type h_num = n * low.numerator() + high.numerator();
-					int_type h_denom = n * low.denominator() + high.denominator();
-
-					//int_type l_num = m * low.numerator() + high.numerator();
-					//int_type l_denom = m * low.denominator() + high.denominator();
-					int_type l_num = h_num + low.numerator();
-					int_type l_denom = h_denom + low.denominator();
+					int_type h_num = l_num - low.numerator();
+					int_type h_denom = l_denom - low.denominator();
 
 					if (DebugReporting) {
-						std::cerr << std::format("Fraction: x1 LT x2: n = {}, h: {}/{}, l: {}/{}</p>\n", n, h_num, h_denom, l_num, l_denom);
+						detail::debugReport("Fraction: x1 LT x2: n = {}, h: {}/{}, l: {}/{}</p>\n", n, h_num, h_denom, l_num, l_denom);
 					}
 
-					low = Fraction<int_type>(l_num, l_denom);
-					high = Fraction<int_type>(h_num, h_denom);
+					low = Node{ l_num, l_denom };
+					high = Node{ h_num, h_denom };
 				}
 				else
 				{
 					//double x2 = testLow / testHigh;
+					Probe next{};
+					int_type n = settle(low, high, -1, stepCount(x2), next);    // lower bound for m
+
+					//     a + x*c
+					//     ------- = m
+					//     b + x*d
+					//int_type h_num = low.numerator() + m * high.numerator();
+					//int_type h_denom = low.denominator() + m * high.denominator();
+					if (next.k != n + 1) {
+						next.k = n + 1;
+						next.fits = step(low, high, n + 1, next.num, next.den);
+					}
+					int_type h_num = next.num, h_denom = next.den;
+
 					// safety checks: are we going to be out of integer bounds?
-					if (low.denominator() + (x2 + 1) * high.denominator() >= double(MaxValue))
+					// (settle() has made sure the n end fits)
+					if (!next.fits)
 					{
+						// the best semiconvergent low + n * high that fits replaces low
+						if (tracer) {
+							detail::traceRecord<int_type>(tracer, traceConversion, traceIteration, trace::Kind::Iteration, trace::StepHigh | trace::Overflow, testLow, testHigh, x1, x2, n, low, high);
+						}
+						if (n > 0)
+							low = Node{ int_type(low.num + n * high.num), int_type(low.den + n * high.den) };
+						overflowed = true;
 						break;
 					}
 
-					int_type n = int_type(x2);    // lower bound for m
+					if (tracer) {
+						detail::traceRecord<int_type>(tracer, traceConversion, traceIteration, trace::Kind::Iteration, trace::StepHigh, testLow, testHigh, x1, x2, n, low, high);
+					}
 					//int_type m = n + 1;    // upper bound for m
 
-					//     a + x*c
-					//     ------- = m
-					//     b + x*d
-					int_type l_num = low.numerator() + n * high.numerator();
-					int_type l_denom = low.denominator() + n * high.denominator();
-
-					//int_type h_num = low.numerator() + m * high.numerator();
-					//int_type h_denom = low.denominator() + m * high.denominator();
-					int_type h_num = l_num + high.numerator();
-					int_type h_denom = l_denom + high.denominator();
+					int_type l_num = h_num - high.numerator();
+					int_type l_denom = h_denom - high.denominator();
 
 					if (DebugReporting) {
-						std::cerr << std::format("Fraction: x1 LT x2: n = {}, h: {}/{}, l: {}/{}\n", n, h_num, h_denom, l_num, l_denom);
+						detail::debugReport("Fraction: x1 LT x2: n = {}, h: {}/{}, l: {}/{}\n", n, h_num, h_denom, l_num, l_denom);
 					}
 
-					high = Fraction<int_type>(h_num, h_denom);
-					low = Fraction<int_type>(l_num, l_denom);
+					high = Node{ h_num, h_denom };
+					low = Node{ l_num, l_denom };
+				}
+				assert(detail::sideOf(low.numerator(), low.denominator(), val) <= 0);
+				assert(detail::sideOf(high.numerator(), high.denominator(), val) >= 0);
+				traceIteration++;
+			}
+
+			if (overflowed)
+			{
+				if (DebugReporting) {
+					detail::debugReport("Fraction: integer range or denominator cap exhausted\n");
 				}
-				assert(toFloat(low) <= val);
-				assert(toFloat(high) >= val);
+				// neither end is within Precision: answer with the closer one (by residual, as the ends
+				// themselves may be closer together than a double can tell apart)
+				double errorLow = detail::residual(low.numerator(), low.denominator(), val) / double(low.denominator());
+				double errorHigh = -detail::residual(high.numerator(), high.denominator(), val) / double(high.denominator());
+				if (errorLow < errorHigh)
+					std::swap(low, high);
 			}
 
-			high += intPart;  // high = fraction(high) + fraction(intPart / 1)
+			// back to Fractions, reduced once per conversion: high + intPart / 1 (step() has made sure its
+			// numerator fits)
+			Fraction<int_type> rv(int_type(high.num + intPart * high.den), high.den);
+
+			if (bracket) {
+				Fraction<int_type> other(int_type(low.num + intPart * low.den), low.den);
+				bracket->low = std::min(other, rv);
+				bracket->high = std::max(other, rv);
+			}
+
+			if (tracer) {
+				detail::traceRecord<int_type>(tracer, traceConversion, traceIteration, trace::Kind::End, 0, val, Precision, 0, 0, intPart, rv, rv);
+			}
 
 			if (DebugReporting)
 			{
-				std::cerr << std::format("Fraction: DONE for {} at precision {}: answer = {}\n", val, Precision, high);
+				detail::debugReport("Fraction: DONE for {} at precision {}: answer = {}\n", val, Precision, rv);
 			}
 
-			return high;
+			return rv;
 		}
 }
 
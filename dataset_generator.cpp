@@ -0,0 +1,120 @@
+
+#include "./dataset_generator.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace cvt_2_fraction;
+
+
+namespace
+{
+	void Usage(const char *argv0)
+	{
+		std::cerr << std::format(
+			"Usage: {} [options]\n"
+			"\n"
+			"  --kind NAME        uniform | exact | decimal | near | quadratic | golden | heavy (default: uniform)\n"
+			"  --count N          number of samples (default: 1000)\n"
+			"  --seed S           RNG seed (default: 0x5EED)\n"
+			"  --lo X --hi X      value range [lo, hi) (default: [0, 1))\n"
+			"  --max-den Q        largest denominator for exact/near (default: 1000)\n"
+			"  --den-dist NAME    uniform | loguniform (default: loguniform)\n"
+			"  --decimals D       digits after the point for 'decimal' (default: 3)\n"
+			"  --ulps U           maximum ULP distance for 'near' (default: 4)\n"
+			"  --alpha A          Pareto tail index for 'heavy' (default: 1.5)\n"
+			"  --out FILE         write to FILE instead of stdout\n"
+			"\n"
+			"Output: one sample per line: the value (shortest round-trip form), followed by\n"
+			"a TAB and the exact num/den it was derived from, when known.\n",
+			argv0);
+	}
+}
+
+
+#if defined(BUILD_MONOLITHIC)
+#define main cvt2frac_dataset_generator_main
+#endif
+
+extern "C"
+int main(int argc, const char **argv) {
+	dataset::Options opts;
+	const char *outPath = nullptr;
+
+	try {
+		for (int i = 1; i < argc; i++) {
+			std::string_view arg = argv[i];
+			if (arg == "-h" || arg == "--help") {
+				Usage(argv[0]);
+				return 0;
+			}
+			if (i + 1 >= argc) {
+				Usage(argv[0]);
+				return 1;
+			}
+			const char *v = argv[++i];
+			if (arg == "--kind")
+				opts.kind = dataset::parseDistribution(v);
+			else if (arg == "--count")
+				opts.count = size_t(std::strtoull(v, nullptr, 0));
+			else if (arg == "--seed")
+				opts.seed = std::strtoull(v, nullptr, 0);
+			else if (arg == "--lo")
+				opts.lo = std::strtod(v, nullptr);
+			else if (arg == "--hi")
+				opts.hi = std::strtod(v, nullptr);
+			else if (arg == "--max-den")
+				opts.maxDenominator = std::strtoll(v, nullptr, 0);
+			else if (arg == "--den-dist") {
+				if (std::strcmp(v, "uniform") == 0)
+					opts.denominators = dataset::DenominatorDistribution::Uniform;
+				else if (std::strcmp(v, "loguniform") == 0)
+					opts.denominators = dataset::DenominatorDistribution::LogUniform;
+				else {
+					Usage(argv[0]);
+					return 1;
+				}
+			}
+			else if (arg == "--decimals")
+				opts.decimals = std::atoi(v);
+			else if (arg == "--ulps")
+				opts.ulpDistance = std::atoi(v);
+			else if (arg == "--alpha")
+				opts.tailAlpha = std::strtod(v, nullptr);
+			else if (arg == "--out")
+				outPath = v;
+			else {
+				Usage(argv[0]);
+				return 1;
+			}
+		}
+
+		std::ofstream file;
+		if (outPath) {
+			file.open(outPath);
+			if (!file) {
+				std::cerr << std::format("cannot open {} for writing\n", outPath);
+				return 1;
+			}
+		}
+		std::ostream &out = outPath ? file : std::cout;
+
+		dataset::Generator gen(opts);
+		for (size_t i = 0; i < opts.count; i++) {
+			dataset::Sample s = gen.next();
+			if (s.denominator)
+				out << std::format("{}\t{}/{}\n", s.value, s.numerator, s.denominator);
+			else
+				out << std::format("{}\n", s.value);
+		}
+	}
+	catch (const std::exception &ex) {
+		std::cerr << ex.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,261 @@
+
+#pragma once
+
+#include "./convert_to_fraction.h"
+
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <numeric>
+#include <random>
+#include <string_view>
+#include <vector>
+#include <exception>
+#include <stdexcept>
+#include <format>
+
+namespace cvt_2_fraction
+{
+	/// <summary>
+	/// <para>Reproducible, seeded input sets for benchmarking and validating the conversion code.</para>
+	///
+	/// <para>
+	/// All randomness is derived from std::mt19937_64, whose output sequence is fixed by the standard,
+	/// and mapped to values with our own arithmetic (the std:: distributions are implementation defined).
+	/// Where that arithmetic is integer or correctly rounded (+ - * / and sqrt), the same seed produces
+	/// the same dataset on every platform and compiler: every distribution except HeavyTailed, with
+	/// Uniform denominators. LogUniform denominators and HeavyTailed magnitudes go through std::exp(),
+	/// std::log() and std::pow(), which are not correctly rounded, so they may differ between math
+	/// libraries (the seed still fixes them on any one platform).</para>
+	/// </summary>
+	namespace dataset
+	{
+		enum class Distribution
+		{
+			UniformReal,            // uniform doubles in [lo, hi)
+			ExactRatio,             // exact p/q, q drawn from the denominator distribution
+			ShortDecimal,           // k / 10^decimals
+			NearRational,           // p/q perturbed by 1..ulpDistance ULPs
+			QuadraticIrrational,    // n + frac(b*sqrt(k)/c)
+			GoldenWorstCase,        // noble numbers: short random prefix followed by an all-ones CF tail
+			HeavyTailed,            // Pareto distributed magnitudes, random sign
+		};
+
+		enum class DenominatorDistribution
+		{
+			Uniform,                // q uniform in [1, maxDenominator]
+			LogUniform,             // log(q) uniform: small denominators are as common as large ones per decade
+		};
+
+		struct Options
+		{
+			Distribution kind = Distribution::UniformReal;
+			uint64_t seed = 0x5EED;
+			size_t count = 1000;
+			double lo = 0.0;
+			double hi = 1.0;
+			int64_t maxDenominator = 1000;
+			DenominatorDistribution denominators = DenominatorDistribution::LogUniform;
+			int decimals = 3;
+			int ulpDistance = 4;
+			double tailAlpha = 1.5;
+			double maxMagnitude = 2147483647.0;
+		};
+
+		/// <summary>
+		/// One generated input. When the generator knows the exact rational the value was derived from
+		/// (ExactRatio, ShortDecimal, NearRational) it is reported as numerator/denominator; otherwise
+		/// denominator == 0.
+		/// </summary>
+		struct Sample
+		{
+			double value;
+			int64_t numerator;
+			int64_t denominator;
+		};
+
+		inline constexpr std::string_view DistributionNames[] = {
+			"uniform", "exact", "decimal", "near", "quadratic", "golden", "heavy",
+		};
+
+		inline std::string_view toString(Distribution kind) {
+			return DistributionNames[size_t(kind)];
+		}
+
+		inline Distribution parseDistribution(std::string_view name) {
+			for (size_t i = 0; i < std::size(DistributionNames); i++) {
+				if (DistributionNames[i] == name)
+					return Distribution(i);
+			}
+			throw std::invalid_argument(std::format("unknown dataset distribution: {}", name));
+		}
+
+		class Generator
+		{
+		public:
+			explicit Generator(const Options &opts)
+				: opts(opts), rng(opts.seed)
+			{
+				if (!(opts.lo < opts.hi))
+					throw std::invalid_argument(std::format("dataset range is empty: [{}, {})", opts.lo, opts.hi));
+				if (opts.maxDenominator < 1)
+					throw std::invalid_argument(std::format("maxDenominator must be positive, got {}", opts.maxDenominator));
+				if (opts.decimals < 0 || opts.decimals > 18)
+					throw std::invalid_argument(std::format("decimals must be in [0, 18], got {}", opts.decimals));
+
+				// the numerators lo * q .. hi * q must fit in int64_t
+				int64_t q = 1;
+				if (opts.kind == Distribution::ShortDecimal) {
+					for (int i = 0; i < opts.decimals; i++)
+						q *= 10;
+				}
+				else if (opts.kind == Distribution::ExactRatio || opts.kind == Distribution::NearRational)
+					q = opts.maxDenominator;
+				if (!(std::max(std::abs(opts.lo), std::abs(opts.hi)) * double(q) < 0x1p63))
+					throw std::invalid_argument(std::format("dataset range [{}, {}) times denominator {} does not fit in 64 bits", opts.lo, opts.hi, q));
+			}
+
+			Sample next() {
+				switch (opts.kind) {
+				case Distribution::UniformReal:
+					return { opts.lo + unit() * (opts.hi - opts.lo), 0, 0 };
+
+				case Distribution::ExactRatio:
+					return exactRatio();
+
+				case Distribution::ShortDecimal:
+					return shortDecimal();
+
+				case Distribution::NearRational:
+					return nearRational();
+
+				case Distribution::QuadraticIrrational:
+					return quadraticIrrational();
+
+				case Distribution::GoldenWorstCase:
+					return goldenWorstCase();
+
+				case Distribution::HeavyTailed:
+					return heavyTailed();
+				}
+				throw std::invalid_argument("unknown dataset distribution");
+			}
+
+			std::vector<Sample> generate() {
+				std::vector<Sample> rv;
+				rv.reserve(opts.count);
+				for (size_t i = 0; i < opts.count; i++)
+					rv.push_back(next());
+				return rv;
+			}
+
+		private:
+			// [0, 1) with 53 bits of randomness
+			double unit() {
+				return double(rng() >> 11) * 0x1.0p-53;
+			}
+
+			// [lo, hi], inclusive; the multiply-high mapping (detail::mulWide) keeps this portable and bias-free enough for datasets
+			int64_t range(int64_t lo, int64_t hi) {
+				uint64_t span = uint64_t(hi) - uint64_t(lo) + 1;
+				if (span == 0)
+					return int64_t(rng());
+				uint64_t offset;
+				detail::mulWide(rng(), span, offset);
+				return lo + int64_t(offset);
+			}
+
+			int64_t denominator() {
+				if (opts.denominators == DenominatorDistribution::Uniform)
+					return range(1, opts.maxDenominator);
+				double q = std::exp(unit() * std::log(double(opts.maxDenominator) + 1.0));
+				return std::clamp<int64_t>(int64_t(q), 1, opts.maxDenominator);
+			}
+
+			int64_t numeratorFor(int64_t q) {
+				int64_t pLo = int64_t(std::ceil(opts.lo * double(q)));
+				int64_t pHi = int64_t(std::ceil(opts.hi * double(q))) - 1;
+				if (pHi < pLo)
+					pHi = pLo;
+				return range(pLo, pHi);
+			}
+
+			static Sample reduced(double value, int64_t p, int64_t q) {
+				int64_t g = std::gcd(p, q);
+				return { value, p / g, q / g };
+			}
+
+			Sample exactRatio() {
+				int64_t q = denominator();
+				int64_t p = numeratorFor(q);
+				return reduced(double(p) / double(q), p, q);
+			}
+
+			Sample shortDecimal() {
+				int64_t q = 1;
+				for (int i = 0; i < opts.decimals; i++)
+					q *= 10;
+				int64_t p = numeratorFor(q);
+				return reduced(double(p) / double(q), p, q);
+			}
+
+			Sample nearRational() {
+				Sample s = exactRatio();
+				int steps = int(range(1, std::max(opts.ulpDistance, 1)));
+				double dir = (rng() & 1) ? std::numeric_limits<double>::infinity() : -std::numeric_limits<double>::infinity();
+				for (int i = 0; i < steps; i++)
+					s.value = std::nextafter(s.value, dir);
+				return s;
+			}
+
+			Sample quadraticIrrational() {
+				int64_t k;
+				for (;;) {
+					k = range(2, 1000);
+					int64_t r = int64_t(std::sqrt(double(k)));
+					if (r * r != k)
+						break;
+				}
+				double b = double(range(1, 16));
+				double c = double(range(1, 16));
+				double x = b * std::sqrt(double(k)) / c;
+				return { integerPart() + (x - std::floor(x)), 0, 0 };
+			}
+
+			Sample goldenWorstCase() {
+				// evaluate [0; a1, ..., am, 1, 1, 1, ...] back to front: the all-ones tail is the golden ratio conjugate,
+				// which makes every x1:x2 step in toFract advance by the smallest possible amount.
+				double x = std::numbers::phi_v<double> - 1.0;
+				int prefix = int(range(0, 4));
+				for (int i = 0; i < prefix; i++)
+					x = 1.0 / (double(range(1, 3)) + x);
+				return { integerPart() + x, 0, 0 };
+			}
+
+			Sample heavyTailed() {
+				double u = 1.0 - unit();    // (0, 1]
+				double magnitude = std::min(std::pow(u, -1.0 / opts.tailAlpha), opts.maxMagnitude);
+				double scale = std::max(std::abs(opts.lo), std::abs(opts.hi));
+				if (scale == 0)
+					scale = 1;
+				magnitude = std::min(magnitude * scale, opts.maxMagnitude);
+				return { (rng() & 1) ? -magnitude : magnitude, 0, 0 };
+			}
+
+			double integerPart() {
+				int64_t lo = int64_t(std::floor(opts.lo));
+				int64_t hi = std::max(lo, int64_t(std::ceil(opts.hi)) - 1);
+				return double(range(lo, hi));
+			}
+
+			Options opts;
+			std::mt19937_64 rng;
+		};
+
+		inline std::vector<Sample> generate(const Options &opts) {
+			return Generator(opts).generate();
+		}
+	}
+}
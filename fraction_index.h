@@ -0,0 +1,228 @@
+
+#pragma once
+
+#include "./convert_to_fraction.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// Hint the next cache line of the descent into L1; a no-op where the compiler has no prefetch builtin.
+#if defined(__GNUC__) || defined(__clang__)
+#define CVT2FRAC_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define CVT2FRAC_PREFETCH(p) ((void)(p))
+#endif
+
+namespace cvt_2_fraction
+{
+	namespace detail
+	{
+		/// <summary>
+		/// sign(a - b), exact: both cross products fit in 128 bits.
+		/// </summary>
+		template<typename int_type>
+		int compareExact(const Fraction<int_type> &a, const Fraction<int_type> &b) {
+			return signOf(Int128(a.numerator()) * b.denominator() - Int128(b.numerator()) * a.denominator());
+		}
+
+		/// <summary>
+		/// sign(a - x), exact: x is taken as the dyadic rational m * 2^e it represents.
+		/// </summary>
+		template<typename int_type>
+		int compareExact(const Fraction<int_type> &a, double x) {
+			return compareExact(int64_t(a.numerator()), int64_t(a.denominator()), x);
+		}
+	}
+
+	/// <summary>
+	/// <para>Immutable, searchable set of fractions: the nearest stored fraction to a value, and all
+	/// stored fractions in a closed interval, each in O(log n).</para>
+	///
+	/// <para>
+	/// The fractions are kept sorted (duplicates removed; indices returned by the queries refer to this
+	/// order, see fractions()) and a second time in Eytzinger (BFS) order, which the descent walks
+	/// top-down with the next levels prefetched. All ordering is exact: fractions are compared by 128-bit
+	/// cross products and doubles as the dyadic rationals they represent, never through toFloat().</para>
+	///
+	/// <para>
+	/// nearest() resolves a tie between the two neighbours of the query towards the smaller one. That
+	/// choice is exact as well: the query is compared with the neighbours' midpoint in 192-bit (Fraction
+	/// queries) or 256-bit (double queries) products.</para>
+	/// </summary>
+	template<typename int_type>
+	class FractionIndex
+	{
+		static_assert(std::is_integral_v<int_type> && sizeof(int_type) <= 8, "FractionIndex needs a builtin integer type");
+
+	public:
+		explicit FractionIndex(std::span<const Fraction<int_type>> fractions)
+			: sorted(fractions.begin(), fractions.end())
+			{
+				auto less = [](const Fraction<int_type> &a, const Fraction<int_type> &b) { return detail::compareExact(a, b) < 0; };
+				std::sort(sorted.begin(), sorted.end(), less);
+				sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+				eytzinger.resize(sorted.size() + 1);
+				rank.resize(sorted.size() + 1);
+				build(0, 1);
+			}
+
+		size_t size() const { return sorted.size(); }
+
+		/// <summary>
+		/// The stored fractions in ascending order.
+		/// </summary>
+		std::span<const Fraction<int_type>> fractions() const { return sorted; }
+
+		const Fraction<int_type> &operator[](size_t i) const { return sorted[i]; }
+
+		/// <summary>
+		/// Index of the first stored fraction &gt;= x (size() if there is none).
+		/// </summary>
+		template<typename value_type>
+		size_t lowerBound(const value_type &x) const {
+				return descend(x, 0);
+			}
+
+		/// <summary>
+		/// Index of the first stored fraction &gt; x (size() if there is none).
+		/// </summary>
+		template<typename value_type>
+		size_t upperBound(const value_type &x) const {
+				return descend(x, 1);
+			}
+
+		/// <summary>
+		/// The stored fractions f with lo &lt;= f &lt;= hi.
+		/// </summary>
+		template<typename value_type>
+		std::span<const Fraction<int_type>> range(const value_type &lo, const value_type &hi) const {
+				size_t first = lowerBound(lo);
+				size_t last = std::max(first, upperBound(hi));
+				return std::span<const Fraction<int_type>>(sorted).subspan(first, last - first);
+			}
+
+		/// <summary>
+		/// Index of the stored fraction closest to x.
+		/// </summary>
+		template<typename value_type>
+		size_t nearest(const value_type &x) const {
+				return pick(x, lowerBound(x));
+			}
+
+		/// <summary>
+		/// out[i] = nearest(xs[i]). Queries are descended in groups, interleaved level by level, so the
+		/// cache misses of one query overlap with the others'.
+		/// </summary>
+		template<typename value_type>
+		void nearest(std::span<const value_type> xs, std::span<size_t> out) const {
+				if (out.size() < xs.size())
+					throw std::invalid_argument(std::format("FractionIndex: {} results for {} queries", out.size(), xs.size()));
+
+				constexpr size_t Lanes = 8;
+				const size_t n = sorted.size();
+				for (size_t base = 0; base < xs.size(); base += Lanes) {
+					const size_t lanes = std::min(Lanes, xs.size() - base);
+					size_t k[Lanes];
+					for (size_t j = 0; j < lanes; j++) {
+						check(xs[base + j]);
+						k[j] = 1;
+					}
+					for (bool active = (n > 0); active;) {
+						active = false;
+						for (size_t j = 0; j < lanes; j++) {
+							if (k[j] > n)
+								continue;
+							CVT2FRAC_PREFETCH(eytzinger.data() + std::min(k[j] * PrefetchStride, n));
+							k[j] = 2 * k[j] + (detail::compareExact(eytzinger[k[j]], xs[base + j]) < 0);
+							active |= (k[j] <= n);
+						}
+					}
+					for (size_t j = 0; j < lanes; j++)
+						out[base + j] = pick(xs[base + j], resolve(k[j]));
+				}
+			}
+
+	private:
+		// the descendants four levels down start at 16 k: prefetch them while the current level is compared
+		static constexpr size_t PrefetchStride = 16;
+
+		size_t build(size_t i, size_t k) {
+				if (k < eytzinger.size()) {
+					i = build(i, 2 * k);
+					eytzinger[k] = sorted[i];
+					rank[k] = i++;
+					i = build(i, 2 * k + 1);
+				}
+				return i;
+			}
+
+		static void check(double x) {
+				if (std::isnan(x))
+					throw std::invalid_argument("FractionIndex: NaN query");
+			}
+
+		static void check(const Fraction<int_type> &) {}
+
+		// leaf k after the descent: strip the trailing right turns (and the last left one) to reach the answer
+		size_t resolve(size_t k) const {
+				k >>= std::countr_one(k) + 1;
+				return k ? rank[k] : sorted.size();
+			}
+
+		// strict = 0: first element >= x; strict = 1: first element > x
+		template<typename value_type>
+		size_t descend(const value_type &x, int strict) const {
+				check(x);
+				const size_t n = sorted.size();
+				size_t k = 1;
+				while (k <= n) {
+					CVT2FRAC_PREFETCH(eytzinger.data() + std::min(k * PrefetchStride, n));
+					k = 2 * k + (detail::compareExact(eytzinger[k], x) < strict);
+				}
+				return resolve(k);
+			}
+
+		// choose between sorted[i - 1] < x <= sorted[i]
+		template<typename value_type>
+		size_t pick(const value_type &x, size_t i) const {
+				if (sorted.empty())
+					throw std::invalid_argument("FractionIndex: nearest() on an empty index");
+				if (i == 0)
+					return 0;
+				if (i == sorted.size())
+					return i - 1;
+				if (detail::compareExact(sorted[i], x) == 0)
+					return i;
+				return closerToHigh(sorted[i - 1], sorted[i], x) ? i : i - 1;
+			}
+
+		static bool closerToHigh(const Fraction<int_type> &a, const Fraction<int_type> &b, const Fraction<int_type> &x) {
+				// x - a = N1 / (q qa), b - x = N2 / (q qb): compare N1 qb with N2 qa
+				using Wide = detail::WideInt<4>;
+				const Wide p(x.numerator()), q(x.denominator());
+				const Wide n1 = p * a.denominator() - Wide(a.numerator()) * q;      // |N1| < 2^127
+				const Wide n2 = Wide(b.numerator()) * q - p * b.denominator();
+				return n1 * b.denominator() > n2 * a.denominator();
+			}
+
+		static bool closerToHigh(const Fraction<int_type> &a, const Fraction<int_type> &b, double x) {
+				// x > (a + b) / 2 = S / D: sign(S - x D) with S = pa qb + pb qa, D = 2 qa qb and x = m 2^e
+				using Wide = detail::WideInt<4>;
+				const Wide S = Wide(a.numerator()) * b.denominator() + Wide(b.numerator()) * a.denominator();   // |S| < 2^127
+				int e;
+				const Wide L = Wide(detail::splitDyadic(x, e)) * a.denominator() * b.denominator() * 2;        // |L| < 2^180
+				return detail::compareScaled<256>(S, L, e) < 0;
+			}
+
+		std::vector<Fraction<int_type>> sorted;
+		std::vector<Fraction<int_type>> eytzinger;  // 1-based, eytzinger[0] unused
+		std::vector<size_t> rank;                   // eytzinger position -> sorted index
+	};
+}
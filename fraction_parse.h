@@ -0,0 +1,231 @@
+
+#pragma once
+
+#include "./convert_to_fraction.h"
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+namespace cvt_2_fraction
+{
+	/// <summary>
+	/// <para>std::from_chars-style parsing of fraction text: the inverse of toString(), toChars() and the std::formatter.</para>
+	///
+	/// <para>
+	/// Accepted forms (no leading whitespace, as with std::from_chars):</para>
+	/// <code>
+	///     n           e.g. "-3"        == -3/1
+	///     n/d         e.g. "16/9"
+	///     n:d         e.g. "16:9"      (aspect ratio notation, cf. DarConverter.ConvertFrom in DAR.cs)
+	///     w n/d       e.g. "-1 3/4"    == -7/4; one or more spaces between w and n, n &gt;= 0
+	/// </code>
+	///
+	/// <para>
+	/// On success ec == std::errc{} and ptr points past the parsed text. Errors are reported like std::from_chars:
+	/// std::errc::invalid_argument (no fraction at `first`, or a zero denominator; ptr == first) and
+	/// std::errc::result_out_of_range (a component or the mixed-form numerator does not fit in int_type; ptr points
+	/// past the text that was recognized). The output is only modified on success.</para>
+	/// </summary>
+	enum class ParseFlags : unsigned
+	{
+		None = 0,
+		Reduce = 1,         // divide numerator and denominator by their gcd and make the denominator positive
+	};
+
+	constexpr ParseFlags operator|(ParseFlags a, ParseFlags b) { return ParseFlags(unsigned(a) | unsigned(b)); }
+	constexpr bool operator&(ParseFlags a, ParseFlags b) { return (unsigned(a) & unsigned(b)) != 0; }
+
+	namespace detail
+	{
+		inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+		template<typename int_type>
+		std::from_chars_result parseDenominator(const char *first, const char *last, int_type &den) {
+			// from_chars() would accept a '-' here; a denominator is written without sign
+			if (first == last || !isDigit(*first))
+				return { first, std::errc::invalid_argument };
+			return std::from_chars(first, last, den);
+		}
+	}
+
+	/// <summary>
+	/// Parse into separate numerator/denominator values. Without ParseFlags::Reduce the values are returned
+	/// as written (the mixed form is still combined into a single numerator).
+	/// </summary>
+	template<typename int_type>
+	std::from_chars_result fromChars(const char *first, const char *last, int_type &numerator, int_type &denominator, ParseFlags flags = ParseFlags::Reduce)
+		{
+			int_type w{};
+			auto [p, ec] = std::from_chars(first, last, w);
+			if (ec != std::errc())
+				return { p, ec };
+
+			int_type num = w;
+			int_type den{1};
+
+			if (p != last && (*p == '/' || *p == ':')) {
+				auto [q, ec2] = detail::parseDenominator(p + 1, last, den);
+				if (ec2 == std::errc::invalid_argument)
+					return { first, ec2 };
+				if (ec2 != std::errc())
+					return { q, ec2 };
+				p = q;
+			}
+			else if (p != last && *p == ' ') {
+				// possibly the mixed form; if what follows isn't "n/d", the integer alone was the fraction
+				const char *s = p;
+				while (s != last && *s == ' ')
+					s++;
+				int_type n{};
+				int_type d{};
+				auto [q, ec2] = detail::parseDenominator(s, last, n);
+				if (ec2 == std::errc() && q != last && (*q == '/' || *q == ':')) {
+					auto [r, ec3] = detail::parseDenominator(q + 1, last, d);
+					if (ec3 == std::errc()) {
+						if (d == 0)
+							return { first, std::errc::invalid_argument };
+						// w n/d == (w*d + sign(w)*n) / d; "-0 1/2" cannot be told apart from "0 1/2" after from_chars()
+						int_type wd;
+						if (checkedMul(w, d, wd) || checkedAdd(wd, (*first == '-' ? int_type(-n) : n), num))
+							return { r, std::errc::result_out_of_range };
+						den = d;
+						p = r;
+					}
+					else if (ec3 == std::errc::result_out_of_range) {
+						return { r, ec3 };
+					}
+				}
+				else if (ec2 == std::errc::result_out_of_range) {
+					return { q, ec2 };
+				}
+			}
+
+			if (den == 0)
+				return { first, std::errc::invalid_argument };
+
+			if (flags & ParseFlags::Reduce) {
+				// the gcd of the magnitudes, unsigned: std::gcd() of the most negative value is undefined
+				// (it divides den > 0, so it fits in int_type again)
+				using uint_type = std::make_unsigned_t<int_type>;
+				const uint_type absNum = (num < 0 ? uint_type(uint_type(0) - uint_type(num)) : uint_type(num));
+				int_type g = int_type(std::gcd(absNum, uint_type(den)));
+				if (g > 1) {
+					num /= g;
+					den /= g;
+				}
+			}
+			numerator = num;
+			denominator = den;
+			return { p, std::errc() };
+		}
+
+	template<typename int_type>
+	std::from_chars_result fromChars(const char *first, const char *last, Fraction<int_type> &value)
+		{
+			int_type num{};
+			int_type den{};
+			std::from_chars_result rv = fromChars<int_type>(first, last, num, den, ParseFlags::Reduce);
+			if (rv.ec == std::errc())
+				value.assign(num, den);
+			return rv;
+		}
+
+	template<typename int_type>
+	std::from_chars_result fromChars(std::string_view text, Fraction<int_type> &value)
+		{
+			return fromChars<int_type>(text.data(), text.data() + text.size(), value);
+		}
+
+	/// <summary>
+	/// <para>std::to_chars-style formatting: writes "n/d" (the text of toString()) into [first, last) without
+	/// allocating, for output paths that must stay off the heap.</para>
+	///
+	/// <para>
+	/// On success ec == std::errc{} and ptr points past the written text (no terminating NUL is written).
+	/// When the text does not fit, ec == std::errc::value_too_large, ptr == last and the contents of
+	/// [first, last) are unspecified.</para>
+	/// </summary>
+	template<typename int_type>
+	std::to_chars_result toChars(char *first, char *last, const Fraction<int_type> &value)
+		{
+			std::to_chars_result rv = std::to_chars(first, last, value.numerator());
+			if (rv.ec != std::errc())
+				return rv;
+			if (rv.ptr == last)
+				return { last, std::errc::value_too_large };
+			*rv.ptr++ = '/';
+			return std::to_chars(rv.ptr, last, value.denominator());
+		}
+
+	/// <summary>
+	/// <para>Batch columnar parser: parses fields[i] into numerators[i] / denominators[i] and records the per-field
+	/// status in status[i] (may be empty). A field is only accepted when the entire field was consumed.</para>
+	///
+	/// <para>Returns the number of fields that failed; their numerator/denominator are set to 0/0.</para>
+	/// </summary>
+	template<typename int_type>
+	size_t parseColumn(std::span<const std::string_view> fields, std::span<int_type> numerators, std::span<int_type> denominators,
+		std::span<std::errc> status = {}, ParseFlags flags = ParseFlags::Reduce)
+		{
+			assert(numerators.size() >= fields.size() && denominators.size() >= fields.size());
+			assert(status.empty() || status.size() >= fields.size());
+
+			size_t errors = 0;
+			for (size_t i = 0; i < fields.size(); i++) {
+				const char *first = fields[i].data();
+				const char *last = first + fields[i].size();
+				auto [p, ec] = fromChars<int_type>(first, last, numerators[i], denominators[i], flags);
+				if (ec == std::errc() && p != last)
+					ec = std::errc::invalid_argument;
+				if (ec != std::errc()) {
+					numerators[i] = 0;
+					denominators[i] = 0;
+					errors++;
+				}
+				if (!status.empty())
+					status[i] = ec;
+			}
+			return errors;
+		}
+
+	/// <summary>
+	/// Batch parser for a delimited buffer (one fraction per `delimiter`-terminated field, e.g. a text column with
+	/// one value per line). Appends to the output columns; returns the number of fields that failed.
+	/// </summary>
+	template<typename int_type>
+	size_t parseColumn(std::string_view buffer, char delimiter, std::vector<int_type> &numerators, std::vector<int_type> &denominators,
+		ParseFlags flags = ParseFlags::Reduce)
+		{
+			size_t errors = 0;
+			const char *p = buffer.data();
+			const char *end = p + buffer.size();
+			while (p < end) {
+				const char *eol = static_cast<const char *>(std::memchr(p, delimiter, size_t(end - p)));
+				if (!eol)
+					eol = end;
+				const char *last = eol;
+				if (delimiter == '\n' && last > p && last[-1] == '\r')
+					last--;
+
+				int_type num{};
+				int_type den{};
+				auto [q, ec] = fromChars<int_type>(p, last, num, den, flags);
+				if (ec != std::errc() || q != last) {
+					num = 0;
+					den = 0;
+					errors++;
+				}
+				numerators.push_back(num);
+				denominators.push_back(den);
+				p = eol + 1;
+			}
+			return errors;
+		}
+}
@@ -0,0 +1,240 @@
+
+#pragma once
+
+#include "./convert_to_fraction.h"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+
+namespace cvt_2_fraction
+{
+	/// <summary>
+	/// Hash of a (reduced) fraction: both components folded into 64 bits and finished with the
+	/// splitmix64 mixer, so the low and the high bits are both usable for bucketing.
+	/// </summary>
+	template<typename int_type>
+	struct FractionHash
+	{
+		static_assert(std::is_integral_v<int_type> && sizeof(int_type) <= 8, "FractionHash needs a builtin integer type");
+
+		size_t operator()(const Fraction<int_type> &frac) const noexcept {
+			uint64_t h = uint64_t(frac.numerator()) * 0x9E3779B97F4A7C15ull ^ uint64_t(frac.denominator());
+			h ^= h >> 30;
+			h *= 0xBF58476D1CE4E5B9ull;
+			h ^= h >> 27;
+			h *= 0x94D049BB133111EBull;
+			h ^= h >> 31;
+			return size_t(h);
+		}
+	};
+
+	/// <summary>
+	/// <para>Interning pool: maps every distinct fraction to a dense 32-bit id (0, 1, 2, ... in order of
+	/// first appearance) and back. A column of ids takes 4 bytes per row instead of 2 * sizeof(int_type),
+	/// and group-bys can index arrays by id.</para>
+	///
+	/// <para>
+	/// intern() and find() may be called from any number of threads: the fraction -> id map is split into
+	/// Shards independently locked sets (shared for lookups, exclusive for inserts). The id -> fraction
+	/// table grows in power-of-two chunks that never move, so operator[] takes no lock; an id may be
+	/// looked up by any thread that obtained it from intern()/find() or through other synchronization.
+	/// Every slot carries a ready flag, set once its fraction is written: at() checks the flag, and size()
+	/// only passes an id once it and every id below it are ready. Publishing never waits, so an intern
+	/// never blocks on another one that took a lower id.</para>
+	///
+	/// <para>
+	/// Fractions are reduced by construction, so equal values always get the same id.</para>
+	/// </summary>
+	template<typename int_type>
+	class FractionPool
+	{
+	public:
+		using Id = uint32_t;
+
+		static constexpr int ShardBits = 6;
+		static constexpr size_t Shards = size_t(1) << ShardBits;
+
+		FractionPool() = default;
+		FractionPool(const FractionPool &) = delete;
+		FractionPool &operator=(const FractionPool &) = delete;
+
+		~FractionPool() {
+			for (auto &chunk : chunks)
+				delete[] chunk.load(std::memory_order_relaxed);
+		}
+
+		/// <summary>
+		/// The id of `frac`, allocating the next free id when it wasn't seen before.
+		/// </summary>
+		Id intern(const Fraction<int_type> &frac) {
+			size_t h = hasher(frac);
+			Shard &shard = shards[h >> (sizeof(size_t) * 8 - ShardBits)];
+			{
+				std::shared_lock<std::shared_mutex> guard(shard.lock);
+				auto it = shard.ids.find(frac);
+				if (it != shard.ids.end())
+					return it->second;
+			}
+
+			std::unique_lock<std::shared_mutex> guard(shard.lock);
+			auto [it, inserted] = shard.ids.emplace(frac, Id(0));
+			if (!inserted)
+				return it->second;
+
+			uint64_t id = next.fetch_add(1, std::memory_order_relaxed);
+			if (id > MaxId) {
+				next.store(MaxId + 1, std::memory_order_relaxed);
+				shard.ids.erase(it);
+				throw std::overflow_error("FractionPool: id space exhausted");
+			}
+			Entry *entry;
+			try {
+				entry = &slot(Id(id));
+			}
+			catch (...) {
+				// the id is lost (its chunk could not be allocated), but later ids must still be published
+				shard.ids.erase(it);
+				guard.unlock();
+				skip(id);
+				throw;
+			}
+			entry->value = frac;
+			it->second = Id(id);
+			publish(*entry);
+			return Id(id);
+		}
+
+		/// <summary>
+		/// Intern every element of `in`; out[i] = intern(in[i]).
+		/// </summary>
+		void intern(std::span<const Fraction<int_type>> in, std::span<Id> out) {
+			if (out.size() < in.size())
+				throw std::invalid_argument(std::format("FractionPool: {} ids for {} fractions", out.size(), in.size()));
+			for (size_t i = 0; i < in.size(); i++)
+				out[i] = intern(in[i]);
+		}
+
+		/// <summary>
+		/// The id of `frac` if it was interned before.
+		/// </summary>
+		std::optional<Id> find(const Fraction<int_type> &frac) const {
+			const Shard &shard = shards[hasher(frac) >> (sizeof(size_t) * 8 - ShardBits)];
+			std::shared_lock<std::shared_mutex> guard(shard.lock);
+			auto it = shard.ids.find(frac);
+			if (it == shard.ids.end())
+				return std::nullopt;
+			return it->second;
+		}
+
+		const Fraction<int_type> &operator[](Id id) const {
+			int k;
+			uint64_t offset;
+			locate(id, k, offset);
+			return chunks[k].load(std::memory_order_acquire)[offset].value;
+		}
+
+		const Fraction<int_type> &at(Id id) const {
+			const Entry *entry = readyEntry(id);
+			if (!entry)
+				throw std::out_of_range(std::format("FractionPool: unknown id {} ({} fractions interned)", id, size()));
+			return entry->value;
+		}
+
+		/// <summary>
+		/// The number of interned fractions; ids are 0 .. size() - 1.
+		/// </summary>
+		size_t size() const {
+			return count.load(std::memory_order_acquire);
+		}
+
+	private:
+		static_assert(std::is_integral_v<int_type>, "FractionPool needs a builtin integer type");
+
+		static constexpr uint64_t MaxId = 0xFFFFFFFEull;    // keep 0xFFFFFFFF free as a "no fraction" marker for callers
+		static constexpr uint64_t ChunkBase = 1024;         // chunk k holds ChunkBase << k entries
+		static constexpr int ChunkCount = 23;               // enough for MaxId + 1 entries
+
+		struct Entry
+		{
+			Fraction<int_type> value;
+			std::atomic<bool> ready{ false };
+		};
+
+		struct alignas(64) Shard
+		{
+			mutable std::shared_mutex lock;
+			std::unordered_map<Fraction<int_type>, Id, FractionHash<int_type>> ids;
+		};
+
+		// ids are taken in one order and written in another: flag the entry, then move size() over every
+		// ready id at its front. Whichever of two interns finishes last moves it over both: the flag store
+		// and the count update are sequentially consistent, so one of them sees the other's write.
+		void publish(Entry &entry) {
+			entry.ready.store(true);
+			advance();
+		}
+
+		void advance() {
+			for (size_t c = count.load(); readyEntry(c) != nullptr;) {
+				if (count.compare_exchange_weak(c, c + 1))
+					c++;
+			}
+		}
+
+		// a lost id has no entry to flag: once size() reaches it, step over it by hand. Only this
+		// out-of-memory path waits for the interns of lower ids.
+		void skip(uint64_t id) {
+			for (size_t c = size_t(id); !count.compare_exchange_weak(c, c + 1); c = size_t(id))
+				std::this_thread::yield();
+			advance();
+		}
+
+		// the entry of `id` once it is ready, else null
+		const Entry *readyEntry(uint64_t id) const {
+			if (id > MaxId)
+				return nullptr;
+			int k;
+			uint64_t offset;
+			locate(Id(id), k, offset);
+			const Entry *chunk = chunks[k].load(std::memory_order_acquire);
+			return (chunk && chunk[offset].ready.load() ? chunk + offset : nullptr);
+		}
+
+		static void locate(Id id, int &k, uint64_t &offset) {
+			uint64_t pos = uint64_t(id) + ChunkBase;
+			k = int(std::bit_width(pos) - std::bit_width(ChunkBase));
+			offset = pos - (ChunkBase << k);
+		}
+
+		Entry &slot(Id id) {
+			int k;
+			uint64_t offset;
+			locate(id, k, offset);
+
+			Entry *chunk = chunks[k].load(std::memory_order_acquire);
+			if (!chunk) {
+				auto fresh = std::make_unique<Entry[]>(size_t(ChunkBase << k));
+				if (chunks[k].compare_exchange_strong(chunk, fresh.get(), std::memory_order_acq_rel))
+					chunk = fresh.release();
+			}
+			return chunk[offset];
+		}
+
+		std::array<Shard, Shards> shards;
+		std::array<std::atomic<Entry *>, ChunkCount> chunks{};
+		std::atomic<uint64_t> next{ 0 };
+		std::atomic<size_t> count{ 0 };
+		FractionHash<int_type> hasher;
+	};
+}
@@ -0,0 +1,235 @@
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+// Define as 0 to compile the tracer out of toFract() entirely; otherwise it costs one relaxed atomic load
+// per conversion while switched off.
+#if !defined(CVT2FRAC_TRACING)
+#define CVT2FRAC_TRACING 1
+#endif
+
+namespace cvt_2_fraction
+{
+	/// <summary>
+	/// <para>Low-overhead binary tracing of the toFract() descent, switchable at run time.</para>
+	///
+	/// <para>
+	/// While enabled, toFract() appends fixed-size records (no formatting, no allocation) to a ring buffer
+	/// owned by the calling thread, so concurrent conversions neither interleave nor contend. The rings
+	/// can be snapshot into a flat record list, written to a binary file and decoded offline into the same
+	/// messages DebugReporting prints.</para>
+	///
+	/// <para>
+	/// Snapshots read the rings without locking out writers: take them after disable(), once in-flight
+	/// conversions have finished. Fraction components are recorded as int64_t.</para>
+	/// </summary>
+	namespace trace
+	{
+		enum class Kind : uint8_t
+		{
+			Begin,          // testLow = fractional part of val, testHigh = precision, n = integer part
+			Iteration,      // one pass through the descent loop, low/high as they were on entry
+			End,            // testLow = fractional part of val, testHigh = precision, high = answer
+		};
+
+		enum Flags : uint8_t
+		{
+			MatchHigh = 1,  // testHigh < precision: high is the answer
+			MatchLow = 2,   // testLow < precision: low is the answer
+			StepLow = 4,    // x1 > x2: n = int(x1), low/high move towards low
+			StepHigh = 8,   // otherwise: n = int(x2)
+			Overflow = 16,  // the integer range guard stopped the descent
+		};
+
+		struct Record
+		{
+			uint32_t conversion;    // per-thread sequence number
+			uint16_t thread;        // registration order of the recording thread
+			uint16_t iteration;
+			Kind kind;
+			uint8_t flags;
+			uint8_t reserved[6];
+			double testLow;
+			double testHigh;
+			double x1;
+			double x2;
+			int64_t n;
+			int64_t lowNum;
+			int64_t lowDen;
+			int64_t highNum;
+			int64_t highDen;
+		};
+		static_assert(sizeof(Record) == 88, "trace records have a fixed on-disk size");
+
+		struct FileHeader
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t recordSize;
+		};
+		constexpr char FileMagic[8] = { 'C', 'V', 'T', '2', 'F', 'T', 'R', 'C' };
+
+		class Ring
+		{
+		public:
+			Ring(size_t capacity, uint16_t thread)
+				: records(std::max<size_t>(capacity, 1)), thread(thread)
+			{}
+
+			void push(Record r) {
+				r.thread = thread;
+				records[size_t(head % records.size())] = r;
+				head++;
+			}
+
+			uint32_t nextConversion() { return conversion++; }
+
+			void copyTo(std::vector<Record> &out) const {
+				uint64_t n = std::min<uint64_t>(head, records.size());
+				for (uint64_t i = head - n; i < head; i++)
+					out.push_back(records[size_t(i % records.size())]);
+			}
+
+		private:
+			std::vector<Record> records;
+			uint64_t head = 0;
+			uint32_t conversion = 0;
+			uint16_t thread;
+		};
+
+		struct Registry
+		{
+			std::mutex lock;
+			std::vector<std::shared_ptr<Ring>> rings;   // kept alive after their thread exits
+			std::atomic<size_t> capacity{ 4096 };
+			std::atomic<bool> enabled{ false };
+		};
+
+		inline Registry &registry() {
+			static Registry r;
+			return r;
+		}
+
+		inline bool enabled() {
+#if CVT2FRAC_TRACING
+			return registry().enabled.load(std::memory_order_relaxed);
+#else
+			return false;
+#endif
+		}
+
+		inline void enable(bool on = true) {
+			registry().enabled.store(on, std::memory_order_relaxed);
+		}
+
+		inline void disable() {
+			enable(false);
+		}
+
+		/// <summary>
+		/// Ring size (in records) for threads that record their first trace after this call.
+		/// </summary>
+		inline void setCapacity(size_t records) {
+			registry().capacity.store(records);
+		}
+
+		inline Ring &localRing() {
+			thread_local std::shared_ptr<Ring> ring = [] {
+				Registry &reg = registry();
+				std::lock_guard<std::mutex> guard(reg.lock);
+				auto r = std::make_shared<Ring>(reg.capacity.load(), uint16_t(reg.rings.size()));
+				reg.rings.push_back(r);
+				return r;
+			}();
+			return *ring;
+		}
+
+		/// <summary>
+		/// All records currently held by all rings, ordered by thread, then oldest first.
+		/// </summary>
+		inline std::vector<Record> snapshot() {
+			Registry &reg = registry();
+			std::lock_guard<std::mutex> guard(reg.lock);
+			std::vector<Record> rv;
+			for (const auto &ring : reg.rings)
+				ring->copyTo(rv);
+			return rv;
+		}
+
+		inline void write(std::ostream &os, const std::vector<Record> &records) {
+			FileHeader h;
+			std::memcpy(h.magic, FileMagic, sizeof(h.magic));
+			h.version = 1;
+			h.recordSize = sizeof(Record);
+			os.write(reinterpret_cast<const char *>(&h), sizeof(h));
+			os.write(reinterpret_cast<const char *>(records.data()), std::streamsize(records.size() * sizeof(Record)));
+		}
+
+		inline std::vector<Record> read(std::istream &is) {
+			FileHeader h;
+			if (!is.read(reinterpret_cast<char *>(&h), sizeof(h)) || std::memcmp(h.magic, FileMagic, sizeof(h.magic)) != 0)
+				throw std::runtime_error("not a fraction trace file");
+			if (h.version != 1 || h.recordSize != sizeof(Record))
+				throw std::runtime_error(std::format("unsupported trace file version {} (record size {})", h.version, h.recordSize));
+			std::vector<Record> rv;
+			Record r;
+			while (is.read(reinterpret_cast<char *>(&r), sizeof(r)))
+				rv.push_back(r);
+			return rv;
+		}
+
+		/// <summary>
+		/// Print the records as the messages toFract() emits with DebugReporting, one block per conversion.
+		/// </summary>
+		inline void decode(std::ostream &os, const std::vector<Record> &records) {
+			const Record *prev = nullptr;
+			for (const Record &r : records) {
+				if (!prev || prev->thread != r.thread || prev->conversion != r.conversion)
+					os << std::format("# thread {}, conversion {}\n", r.thread, r.conversion);
+				prev = &r;
+
+				switch (r.kind) {
+				case Kind::Begin:
+					os << std::format("Fraction: val = {}, precision = {}\n", r.testLow + double(r.n), r.testHigh);
+					os << std::format("Fraction: val = {}, precision = {}, intpart = {}\n", r.testLow, r.testHigh, r.n);
+					break;
+
+				case Kind::Iteration:
+					os << std::format("Fraction: testlow = {} (fraction: {}/{}), testhigh = {} (fraction: {}/{})\n",
+						r.testLow, r.lowNum, r.lowDen, r.testHigh, r.highNum, r.highDen);
+					if (r.flags & (StepLow | StepHigh))
+						os << std::format("Fraction: x1 = {}, x2 = {}, fraction = {}/{}\n", r.x1, r.x2, r.highNum, r.highDen);
+					if (r.flags & Overflow) {
+						os << "Fraction: integer range exhausted\n";
+					}
+					else if (r.flags & StepLow) {
+						int64_t hNum = r.n * r.lowNum + r.highNum;
+						int64_t hDen = r.n * r.lowDen + r.highDen;
+						os << std::format("Fraction: x1 LT x2: n = {}, h: {}/{}, l: {}/{}</p>\n", r.n, hNum, hDen, hNum + r.lowNum, hDen + r.lowDen);
+					}
+					else if (r.flags & StepHigh) {
+						int64_t lNum = r.lowNum + r.n * r.highNum;
+						int64_t lDen = r.lowDen + r.n * r.highDen;
+						os << std::format("Fraction: x1 LT x2: n = {}, h: {}/{}, l: {}/{}\n", r.n, lNum + r.highNum, lDen + r.highDen, lNum, lDen);
+					}
+					break;
+
+				case Kind::End:
+					os << std::format("Fraction: DONE for {} at precision {}: answer = {}/{}\n", r.testLow, r.testHigh, r.highNum, r.highDen);
+					break;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,541 @@
+
+// the diagnostic output of toFract() would drown the fuzzer's own
+#if !defined(CVT2FRAC_DEBUG_REPORTING)
+#define CVT2FRAC_DEBUG_REPORTING 0
+#endif
+
+#include "./cf_arithmetic.h"
+#include "./cf_matrix.h"
+#include "./convert_to_fraction.h"
+#include "./fraction_index.h"
+#include "./prepared_fraction.h"
+
+#include <boost/multiprecision/cpp_int.hpp>
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace cvt_2_fraction;
+
+
+/// <summary>
+/// <para>Differential fuzz target for the conversion engines: every input is decoded into a value, a
+/// precision and an engine, and the engine's answer is checked against exact rational arithmetic
+/// (boost::multiprecision), never against another double computation. A failed check prints the
+/// input and aborts, which is what libFuzzer reports as a crash.</para>
+///
+/// <para>
+/// Engines and what is checked:</para>
+/// <code>
+///     toFract&lt;int16_t/int32_t/int64_t&gt;  throws exactly for NaN and |val| &gt;= max; the bracket holds
+///                                       low &lt;= val &lt;= high exactly and the answer is one of its ends,
+///                                       which lie on the Stern-Brocot path of val (convergents and
+///                                       semiconvergents of its exact expansion) unless one is val; the answer
+///                                       meets |q val - p| &lt; Precision unless the next mediant does not
+///                                       fit, in which case it is the closer end
+///     toFraction(cfOf(exact val))       the exact integer engine: a convergent of val within Precision,
+///                                       or the last one that fits
+///     PreparedFraction::apply           the SIMD batch against 128-bit floor/nearest/ceil division
+///     FractionIndex::nearest            the batch table lookup against a linear scan
+///     fromCoefficients (batch)          the SIMD batch decoder against the multiprecision matrix product
+/// </code>
+///
+/// <para>
+/// Build for libFuzzer with clang++ -fsanitize=fuzzer,address -DCVT2FRAC_LIBFUZZER. Without
+/// CVT2FRAC_LIBFUZZER the program has its own main: it replays the input files given on the command
+/// line (crash reproducers, a corpus), or runs a number of random inputs.</para>
+/// </summary>
+namespace
+{
+	using big = boost::multiprecision::cpp_int;
+	using rational = boost::multiprecision::cpp_rational;
+
+	enum class Engine : uint8_t
+	{
+		Mediant16,
+		Mediant32,
+		Mediant64,
+		ContinuedFraction,
+		PreparedBatch,
+		IndexLookup,
+		CoefficientBatch,
+		Count
+	};
+
+	constexpr const char *EngineNames[] = {
+		"toFract<int16_t>", "toFract<int32_t>", "toFract<int64_t>", "toFraction(cfOf)", "PreparedFraction::apply",
+		"FractionIndex::nearest", "fromCoefficients (batch)",
+	};
+
+	// fuzz input, consumed front to back; reads past the end give zeros
+	class Reader
+	{
+	public:
+		Reader(const uint8_t *data, size_t size)
+			: p(data), end(data + size)
+		{}
+
+		template<typename T>
+		T read() {
+			uint8_t buf[sizeof(T)] = {};
+			size_t n = std::min(sizeof(T), size_t(end - p));
+			std::memcpy(buf, p, n);
+			p += n;
+			T rv;
+			std::memcpy(&rv, buf, sizeof(T));
+			return rv;
+		}
+
+		size_t remaining() const { return size_t(end - p); }
+
+	private:
+		const uint8_t *p;
+		const uint8_t *end;
+	};
+
+	[[noreturn]] void Fail(Engine engine, const std::string &what)
+	{
+		std::cerr << std::format("fuzz_convert: {}: {}\n", EngineNames[size_t(engine)], what);
+		std::abort();
+	}
+
+	template<typename int_type>
+	rational Exact(const Fraction<int_type> &f)
+	{
+		return rational(big(f.numerator()), big(f.denominator()));
+	}
+
+	std::string Str(const rational &r)
+	{
+		return r.str();
+	}
+
+	// any positive, finite precision; the raw bits make up the rest
+	double DecodePrecision(uint64_t bits)
+	{
+		double p = std::abs(std::bit_cast<double>(bits));
+		return (p > 0 && std::isfinite(p)) ? p : 1E-9;
+	}
+
+	/// <summary>
+	/// Whether p/q (lowest terms, q &gt; 0) is a node on the Stern-Brocot path of x: a convergent or a
+	/// semiconvergent (h_(i-2) + j h_(i-1)) / (k_(i-2) + j k_(i-1)), 1 &lt;= j &lt;= a_i, of its exact expansion.
+	/// </summary>
+	bool OnSternBrocotPath(const rational &x, const big &p, const big &q)
+	{
+		big num = numerator(x), den = denominator(x);
+		// a0 = floor(x)
+		big a = num / den;
+		if (num % den != 0 && num < 0)
+			a -= 1;
+		if (q == 1)
+			return p == a || p == a + 1;
+
+		big h2 = 0, k2 = 1, h1 = 1, k1 = 0;     // h_(i-2)/k_(i-2), h_(i-1)/k_(i-1)
+		for (;;) {
+			if (k1 > 0) {
+				big j = (q - k2) / k1;
+				if (j >= 1 && j <= a && (q - k2) % k1 == 0 && p == h2 + j * h1)
+					return true;
+			}
+			big h = a * h1 + h2, k = a * k1 + k2;
+			h2 = h1; k2 = k1;
+			h1 = h; k1 = k;
+			if (k2 > q)
+				return false;
+			// next term of num/den
+			big r = num - a * den;
+			if (r == 0)
+				return false;
+			num = den;
+			den = r;
+			a = num / den;
+		}
+	}
+
+	/// <summary>
+	/// All convergents h_i/k_i of x, a rational with a short expansion.
+	/// </summary>
+	std::vector<std::pair<big, big>> Convergents(const rational &x)
+	{
+		std::vector<std::pair<big, big>> rv;
+		big num = numerator(x), den = denominator(x);
+		big h2 = 0, k2 = 1, h1 = 1, k1 = 0;
+		for (;;) {
+			big a = num / den;
+			if (num % den != 0 && num < 0)
+				a -= 1;
+			big h = a * h1 + h2, k = a * k1 + k2;
+			rv.emplace_back(h, k);
+			h2 = h1; k2 = k1;
+			h1 = h; k1 = k;
+			big r = num - a * den;
+			if (r == 0)
+				return rv;
+			num = den;
+			den = r;
+		}
+	}
+
+	template<typename int_type>
+	void CheckMediant(Engine engine, Reader &in)
+	{
+		constexpr int_type MaxValue{std::numeric_limits<int_type>::max()};
+		const double val = std::bit_cast<double>(in.read<uint64_t>());
+		const double precision = DecodePrecision(in.read<uint64_t>());
+
+		FractionBracket<int_type> bracket;
+		Fraction<int_type> f;
+		const bool representable = std::abs(val) < double(MaxValue);
+		try {
+			f = toFract<int_type>(val, precision, &bracket);
+		}
+		catch (const std::invalid_argument &) {
+			if (representable)
+				Fail(engine, std::format("val = {:a}, precision = {:a}: unexpected invalid_argument", val, precision));
+			return;
+		}
+		if (!representable)
+			Fail(engine, std::format("val = {:a} does not fit, but toFract() returned {}", val, f));
+
+		const rational x(val);
+		const rational low = Exact(bracket.low), high = Exact(bracket.high), answer = Exact(f);
+		auto where = [&] {
+			return std::format("val = {:a}, precision = {:a}: answer {}, bracket [{}, {}]", val, precision, f, bracket.low, bracket.high);
+		};
+		if (!(low <= x && x <= high))
+			Fail(engine, where() + ": val is outside the bracket");
+		if (f != bracket.low && f != bracket.high)
+			Fail(engine, where() + ": the answer is not a bracket end");
+		// (once the descent hits val itself, the other end may be one of val's descendants)
+		for (const Fraction<int_type> &end : { bracket.low, bracket.high }) {
+			if ((Exact(end) == x || (low != x && high != x)) && !OnSternBrocotPath(x, big(end.numerator()), big(end.denominator())))
+				Fail(engine, where() + std::format(": {} is not on the Stern-Brocot path of {}", end, Str(x)));
+		}
+
+		// |q val - p| < Precision, allowing for the one rounding of the residual toFract() computes
+		rational residual = abs(x * big(f.denominator()) - big(f.numerator()));
+		if (residual < rational(precision) * rational(1 + std::ldexp(1.0, -50)))
+			return;
+		// otherwise the descent must have run out of integer range: the next mediant does not fit
+		big mediantNum = big(bracket.low.numerator()) + big(bracket.high.numerator());
+		big mediantDen = big(bracket.low.denominator()) + big(bracket.high.denominator());
+		if (abs(mediantNum) <= big(MaxValue) && mediantDen <= big(MaxValue))
+			Fail(engine, where() + std::format(": residual {} is not below the precision", Str(residual)));
+		const Fraction<int_type> &other = (f == bracket.low ? bracket.high : bracket.low);
+		if (abs(answer - x) > abs(Exact(other) - x))
+			Fail(engine, where() + ": range exhausted, but the answer is not the closer end");
+	}
+
+	void CheckContinuedFraction(Engine engine, Reader &in)
+	{
+		const double val = std::bit_cast<double>(in.read<uint64_t>());
+		const double precision = DecodePrecision(in.read<uint64_t>());
+		if (!std::isfinite(val))
+			return;
+
+		// the exact expansion of the double is only available while it fits in int64_t
+		const rational x(val);
+		if (abs(numerator(x)) > big(std::numeric_limits<int64_t>::max()) || denominator(x) > big(std::numeric_limits<int64_t>::max()))
+			return;
+		Fraction<int64_t> exact(int64_t(numerator(x)), int64_t(denominator(x)));
+		Fraction<int64_t> f = toFraction<int64_t>(cfOf<int64_t>(exact), precision);
+
+		auto where = [&] {
+			return std::format("val = {:a}, precision = {:a}: answer {}", val, precision, f);
+		};
+		std::vector<std::pair<big, big>> convergents = Convergents(x);
+		size_t n = 0;
+		while (n < convergents.size() && convergents[n] != std::pair<big, big>(big(f.numerator()), big(f.denominator())))
+			n++;
+		if (n == convergents.size())
+			Fail(engine, where() + ": not a convergent");
+		// |x - p_n/q_n| <= 1/(q_(n-1) q_n) < Precision is what the engine stops on; short of that, only the
+		// end of the expansion or a successor that does not fit in int64_t stops it
+		if (abs(Exact(f) - x) >= rational(precision) && n + 1 < convergents.size()) {
+			const big max = std::numeric_limits<int64_t>::max();
+			if (abs(convergents[n + 1].first) <= max && convergents[n + 1].second <= max)
+				Fail(engine, where() + std::format(": stopped before {}/{}", convergents[n + 1].first.str(), convergents[n + 1].second.str()));
+		}
+	}
+
+	// floor(n / d) for d > 0
+	big FloorDiv(const big &n, const big &d)
+	{
+		big q = n / d;
+		return (n % d != 0 && n < 0) ? big(q - 1) : q;
+	}
+
+	void CheckPreparedBatch(Engine engine, Reader &in)
+	{
+		int64_t num = in.read<int64_t>() % 0xFFFFFFFFll;
+		int64_t den = int64_t(in.read<uint32_t>() & 0x7FFFFFFF);
+		if (den == 0)
+			den = 1;
+		const Fraction<int64_t> frac(num, den);
+		const PreparedFraction<int64_t> prepared(frac);
+
+		std::vector<int32_t> xs;
+		while (in.remaining() >= sizeof(int32_t) && xs.size() < 64)
+			xs.push_back(in.read<int32_t>());
+		std::vector<int64_t> out(xs.size());
+		for (ScaleRounding rounding : { ScaleRounding::Floor, ScaleRounding::Nearest, ScaleRounding::Ceil }) {
+			prepared.apply(xs, out, rounding);
+			const big n = frac.numerator(), d = frac.denominator();
+			for (size_t i = 0; i < xs.size(); i++) {
+				const big t = big(xs[i]) * n;
+				const big expected = (rounding == ScaleRounding::Floor) ? FloorDiv(t, d)
+					: (rounding == ScaleRounding::Nearest) ? FloorDiv(2 * t + d, 2 * d)
+					: big(-FloorDiv(-t, d));
+				if (big(out[i]) != expected)
+					Fail(engine, std::format("{} * {} (mode {}): {} instead of {}", xs[i], frac, int(rounding), out[i], expected.str()));
+			}
+		}
+	}
+
+	void CheckIndexLookup(Engine engine, Reader &in)
+	{
+		size_t count = 1 + in.read<uint8_t>() % 32;
+		std::vector<Fraction<int64_t>> stored;
+		for (size_t i = 0; i < count; i++) {
+			int64_t num = in.read<int64_t>();
+			int64_t den = int64_t(in.read<uint64_t>() & 0x7FFFFFFFFFFFFFFF);
+			if (num == std::numeric_limits<int64_t>::min())
+				num++;
+			stored.emplace_back(num, den ? den : 1);
+		}
+		const FractionIndex<int64_t> index(stored);
+
+		std::vector<double> queries;
+		while (in.remaining() >= sizeof(double) && queries.size() < 32) {
+			double q = std::bit_cast<double>(in.read<uint64_t>());
+			if (std::isfinite(q))
+				queries.push_back(q);
+		}
+		std::vector<size_t> found(queries.size());
+		index.nearest(std::span<const double>(queries), std::span<size_t>(found));
+
+		for (size_t i = 0; i < queries.size(); i++) {
+			const rational x(queries[i]);
+			const rational best = abs(Exact(index[found[i]]) - x);
+			if (found[i] != index.nearest(queries[i]))
+				Fail(engine, std::format("query {:a}: the batch and the single lookup disagree", queries[i]));
+			for (const Fraction<int64_t> &f : index.fractions()) {
+				rational d = abs(Exact(f) - x);
+				// exact, ties going to the smaller fraction
+				if (d < best || (d == best && Exact(f) < Exact(index[found[i]])))
+					Fail(engine, std::format("query {:a}: {} is nearer than {}", queries[i], f, index[found[i]]));
+			}
+		}
+	}
+
+	void CheckCoefficientBatch(Engine engine, Reader &in)
+	{
+		size_t count = 1 + in.read<uint8_t>() % 8;
+		std::vector<int64_t> terms;
+		std::vector<size_t> offsets = { 0 };
+		for (size_t k = 0; k < count; k++) {
+			size_t len = 1 + in.read<uint8_t>() % 16;
+			terms.push_back(in.read<int8_t>());
+			for (size_t i = 1; i < len; i++) {
+				// mostly small terms, some beyond the 32-bit vector lanes
+				uint8_t kind = in.read<uint8_t>();
+				terms.push_back((kind & 0x80) ? int64_t(1 + in.read<uint64_t>() % 0xFFFFFFFFFFFull) : int64_t(1 + kind));
+			}
+			offsets.push_back(terms.size());
+		}
+
+		std::vector<int64_t> num(count), den(count);
+		bool overflowed = false;
+		try {
+			fromCoefficients(terms, offsets, num, den);
+		}
+		catch (const std::overflow_error &) {
+			overflowed = true;
+		}
+
+		// the exact values, and whether the checked recurrence can overflow on the way
+		bool fits = true;
+		for (size_t k = 0; k < count; k++) {
+			big p1 = 1, p0 = 0, q1 = 0, q0 = 1;
+			for (size_t i = offsets[k]; i < offsets[k + 1]; i++) {
+				big a = terms[i];
+				for (const big &v : { big(a * p1), big(a * q1), big(a * p1 + p0), big(a * q1 + q0) }) {
+					if (abs(v) > big(std::numeric_limits<int64_t>::max()))
+						fits = false;
+				}
+				big p = a * p1 + p0, q = a * q1 + q0;
+				p0 = p1; q0 = q1;
+				p1 = p; q1 = q;
+			}
+			if (!overflowed && (big(num[k]) != p1 || big(den[k]) != q1))
+				Fail(engine, std::format("sequence {}: {}/{} instead of {}/{}", k, num[k], den[k], p1.str(), q1.str()));
+		}
+		if (overflowed && fits)
+			Fail(engine, "overflow_error although every convergent fits in int64_t");
+	}
+
+	void RunOne(const uint8_t *data, size_t size)
+	{
+		if (size == 0)
+			return;
+		Reader in(data + 1, size - 1);
+		Engine engine = Engine(data[0] % uint8_t(Engine::Count));
+		switch (engine) {
+		case Engine::Mediant16:
+			CheckMediant<int16_t>(engine, in);
+			break;
+		case Engine::Mediant32:
+			CheckMediant<int32_t>(engine, in);
+			break;
+		case Engine::Mediant64:
+			CheckMediant<int64_t>(engine, in);
+			break;
+		case Engine::ContinuedFraction:
+			CheckContinuedFraction(engine, in);
+			break;
+		case Engine::PreparedBatch:
+			CheckPreparedBatch(engine, in);
+			break;
+		case Engine::IndexLookup:
+			CheckIndexLookup(engine, in);
+			break;
+		case Engine::CoefficientBatch:
+			CheckCoefficientBatch(engine, in);
+			break;
+		case Engine::Count:
+			break;
+		}
+	}
+}
+
+
+extern "C"
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	RunOne(data, size);
+	return 0;
+}
+
+
+#if !defined(CVT2FRAC_LIBFUZZER)
+
+namespace
+{
+	void Usage(const char *argv0)
+	{
+		std::cerr << std::format(
+			"Usage: {} [options] [FILE...]\n"
+			"\n"
+			"Differential checks of the conversion engines against exact arithmetic. Replays\n"
+			"the given input files (e.g. libFuzzer crash reproducers), otherwise runs random inputs.\n"
+			"\n"
+			"  --runs N           random inputs to run (default: 100000)\n"
+			"  --seed S           random seed (default: 0x5EED)\n",
+			argv0);
+	}
+
+	// random inputs with a bias towards the values the engines find hard: exact and near rationals,
+	// tiny and huge magnitudes, precisions down to the last bits of a double
+	std::vector<uint8_t> RandomInput(std::mt19937_64 &rng)
+	{
+		std::vector<uint8_t> rv(1 + 8 * (2 + rng() % 24));
+		for (uint8_t &b : rv)
+			b = uint8_t(rng());
+		if (rng() % 2) {
+			double val;
+			switch (rng() % 4) {
+			case 0:
+				val = double(int64_t(rng() % 2000001) - 1000000) / double(1 + rng() % 100000);
+				break;
+			case 1:
+				val = std::nextafter(double(rng() % 1000) / double(1 + rng() % 1000), (rng() % 2) ? 0.0 : 2.0);
+				break;
+			case 2:
+				val = std::ldexp(double(rng() >> 11), int(rng() % 140) - 120);
+				break;
+			default:
+				val = std::bit_cast<double>(rng());
+				break;
+			}
+			double precision = std::ldexp(1.0, -int(rng() % 70));
+			std::memcpy(rv.data() + 1, &val, sizeof(val));
+			std::memcpy(rv.data() + 9, &precision, sizeof(precision));
+		}
+		return rv;
+	}
+}
+
+
+#if defined(BUILD_MONOLITHIC)
+#define main cvt2frac_fuzz_convert_main
+#endif
+
+extern "C"
+int main(int argc, const char **argv) {
+	size_t runs = 100000;
+	uint64_t seed = 0x5EED;
+	std::vector<std::string> files;
+
+	try {
+		for (int i = 1; i < argc; i++) {
+			std::string_view arg = argv[i];
+			if (arg == "-h" || arg == "--help") {
+				Usage(argv[0]);
+				return 0;
+			}
+			if (arg == "--runs" || arg == "--seed") {
+				if (i + 1 >= argc) {
+					Usage(argv[0]);
+					return 1;
+				}
+				const char *v = argv[++i];
+				if (arg == "--runs")
+					runs = size_t(std::strtoull(v, nullptr, 0));
+				else
+					seed = std::strtoull(v, nullptr, 0);
+				continue;
+			}
+			files.emplace_back(arg);
+		}
+
+		if (!files.empty()) {
+			for (const std::string &name : files) {
+				std::ifstream file(name, std::ios::binary);
+				if (!file) {
+					std::cerr << std::format("cannot open {}\n", name);
+					return 1;
+				}
+				std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+				RunOne(data.data(), data.size());
+			}
+			std::cout << std::format("{} input(s) passed\n", files.size());
+			return 0;
+		}
+
+		std::mt19937_64 rng(seed);
+		for (size_t r = 0; r < runs; r++) {
+			std::vector<uint8_t> data = RandomInput(rng);
+			RunOne(data.data(), data.size());
+		}
+		std::cout << std::format("{} random input(s) passed\n", runs);
+	}
+	catch (const std::exception &ex) {
+		std::cerr << ex.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+#endif
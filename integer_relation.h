@@ -0,0 +1,335 @@
+
+#pragma once
+
+#include "./convert_to_fraction.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace cvt_2_fraction
+{
+	/// <summary>
+	/// <para>Double-double arithmetic: a value hi + lo with |lo| &lt;= ulp(hi) / 2, about 106 bits of
+	/// precision from error-free transformations (twoSum(), fma() products). Just the operations
+	/// IntegerRelationFinder needs.</para>
+	/// </summary>
+	struct DoubleDouble
+	{
+		double hi = 0;
+		double lo = 0;
+
+		DoubleDouble() = default;
+		DoubleDouble(double v) : hi(v) {}
+		DoubleDouble(double hi, double lo) : hi(hi), lo(lo) {}
+
+		explicit operator double() const { return hi + lo; }
+
+		static DoubleDouble twoSum(double a, double b) {
+				double s = a + b;
+				double bb = s - a;
+				return { s, (a - (s - bb)) + (b - bb) };
+			}
+
+		static DoubleDouble quickTwoSum(double a, double b) {
+				double s = a + b;
+				return { s, b - (s - a) };
+			}
+
+		friend DoubleDouble operator-(const DoubleDouble &x) { return { -x.hi, -x.lo }; }
+
+		friend DoubleDouble operator+(const DoubleDouble &x, const DoubleDouble &y) {
+				DoubleDouble s = twoSum(x.hi, y.hi), t = twoSum(x.lo, y.lo);
+				s.lo += t.hi;
+				s = quickTwoSum(s.hi, s.lo);
+				s.lo += t.lo;
+				return quickTwoSum(s.hi, s.lo);
+			}
+
+		friend DoubleDouble operator-(const DoubleDouble &x, const DoubleDouble &y) { return x + -y; }
+
+		friend DoubleDouble operator*(const DoubleDouble &x, const DoubleDouble &y) {
+				double p = x.hi * y.hi;
+				double e = std::fma(x.hi, y.hi, -p);
+				e += x.hi * y.lo + x.lo * y.hi;
+				return quickTwoSum(p, e);
+			}
+
+		friend DoubleDouble operator/(const DoubleDouble &x, const DoubleDouble &y) {
+				double q1 = x.hi / y.hi;
+				DoubleDouble r = x - y * q1;
+				double q2 = r.hi / y.hi;
+				r = r - y * q2;
+				double q3 = r.hi / y.hi;
+				return quickTwoSum(q1, q2) + q3;
+			}
+
+		DoubleDouble &operator+=(const DoubleDouble &y) { return *this = *this + y; }
+		DoubleDouble &operator-=(const DoubleDouble &y) { return *this = *this - y; }
+
+		friend bool operator<(const DoubleDouble &x, const DoubleDouble &y) { return x.hi < y.hi || (x.hi == y.hi && x.lo < y.lo); }
+		friend bool operator>(const DoubleDouble &x, const DoubleDouble &y) { return y < x; }
+
+		friend DoubleDouble abs(const DoubleDouble &x) { return x.hi < 0 ? -x : x; }
+
+		friend DoubleDouble sqrt(const DoubleDouble &x) {
+				if (!(x.hi > 0))
+					return DoubleDouble();
+				// one Newton step from the double root doubles its precision
+				double a = std::sqrt(x.hi);
+				DoubleDouble r = x - DoubleDouble(a) * DoubleDouble(a);
+				return quickTwoSum(a, r.hi * (0.5 / a));
+			}
+
+		// the nearest integer (ties away from zero, like std::round)
+		friend DoubleDouble round(const DoubleDouble &x) {
+				double hi = std::round(x.hi);
+				if (hi == x.hi)
+					return quickTwoSum(hi, std::round(x.lo));
+				// x.hi is not an integer, so |x.hi| < 2^52 and x.lo only matters on a tie
+				if (std::abs(hi - x.hi) == 0.5 && x.lo != 0 && (x.lo < 0) == (hi > x.hi))
+					hi = (hi > x.hi ? hi - 1 : hi + 1);
+				return DoubleDouble(hi);
+			}
+	};
+
+	struct RelationOptions
+	{
+		double tolerance = 1E-12;       // |sum a_i x_i| <= tolerance * |x| (Euclidean norm)
+		int64_t maxCoefficient = 100000;
+		int maxIterations = 10000;
+	};
+
+	/// <summary>
+	/// <para>Integer relation detection: integers a_1 ... a_n, not all zero and at most maxCoefficient in
+	/// magnitude, with |a_1 x_1 + ... + a_n x_n| &lt;= tolerance |x|. For n = 2 this is b m - a ~= 0, the
+	/// relation toFract() finds for m = a / b; PSLQ (Ferguson and Bailey) generalizes that descent to n
+	/// values.</para>
+	///
+	/// <para>
+	/// The iteration keeps a lower trapezoidal matrix H and the integer matrix B with y = x B, reducing H
+	/// and swapping the rows with the largest weighted diagonal until some y_j is below the tolerance:
+	/// then column j of B is the relation. 1 / max |H_jj| bounds the norm of every relation from below, so
+	/// the search stops as soon as no relation within maxCoefficient can remain. real_type is the
+	/// arithmetic of H and y: DoubleDouble by default, as double rounding misleads the reductions long
+	/// before double's 53 bits are used up by the relation; double works for short, well-conditioned
+	/// inputs.</para>
+	///
+	/// <para>
+	/// The finder owns its work matrices, so finding relations between values of one size (per frame, in
+	/// batches) allocates nothing after construction.</para>
+	/// </summary>
+	template<typename real_type = DoubleDouble>
+	class IntegerRelationFinder
+	{
+	public:
+		explicit IntegerRelationFinder(size_t n, const RelationOptions &opts = {})
+			: n(n), opts(opts), x(n), y(n), s(n), H(n * n), B(n * n), found(n)
+			{
+				if (n < 2 || n > 64)
+					throw std::invalid_argument(std::format("IntegerRelationFinder: cannot find relations between {} values", n));
+				if (!(opts.tolerance > 0 && opts.tolerance < 1) || opts.maxCoefficient < 1 || opts.maxIterations < 1)
+					throw std::invalid_argument("IntegerRelationFinder: invalid options");
+			}
+
+		size_t size() const { return n; }
+
+		/// <summary>
+		/// A relation between the n values in `values`, stored in `relation` with its first non-zero
+		/// coefficient positive; false (and `relation` all zero) when there is none within the bounds.
+		/// </summary>
+		bool find(std::span<const double> values, std::span<int64_t> relation) {
+				if (values.size() != n || relation.size() != n)
+					throw std::invalid_argument(std::format("IntegerRelationFinder: {} values and {} coefficients, not {}", values.size(), relation.size(), n));
+				std::fill(relation.begin(), relation.end(), 0);
+
+				double norm = 0;
+				for (double v : values) {
+					if (!std::isfinite(v))
+						throw std::invalid_argument(std::format("IntegerRelationFinder: cannot relate {}", v));
+					norm = std::max(norm, std::abs(v));
+				}
+				if (norm == 0) {
+					relation[0] = 1;
+					return true;
+				}
+				// a (near) zero value is a relation by itself, and would leave H singular
+				for (size_t i = 0; i < n; i++) {
+					if (std::abs(values[i]) <= opts.tolerance * norm) {
+						relation[i] = 1;
+						return true;
+					}
+				}
+
+				if (!search(values))
+					return false;
+				std::copy(found.begin(), found.end(), relation.begin());
+				return true;
+			}
+
+		/// <summary>
+		/// find() for consecutive groups of n values: rows.size() / n relations, all zero where there is
+		/// none. Returns the number found.
+		/// </summary>
+		size_t find(std::span<const double> rows, std::span<int64_t> relations, size_t count) {
+				if (rows.size() < count * n || relations.size() < count * n)
+					throw std::invalid_argument(std::format("IntegerRelationFinder: {} rows need {} values and coefficients", count, count * n));
+				size_t rv = 0;
+				for (size_t r = 0; r < count; r++)
+					rv += find(rows.subspan(r * n, n), relations.subspan(r * n, n)) ? 1 : 0;
+				return rv;
+			}
+
+	private:
+		real_type &h(size_t i, size_t j) { return H[i * n + j]; }
+		int64_t &b(size_t i, size_t j) { return B[i * n + j]; }
+
+		static real_type nearest(const real_type &v) {
+				using std::round;
+				return round(v);
+			}
+
+		bool search(std::span<const double> values) {
+				using std::abs;
+				using std::sqrt;
+				const real_type gamma = sqrt(real_type(4) / real_type(3));
+
+				// x normalized; s_j = |(x_j, ..., x_(n-1))|
+				real_type sum(0);
+				for (size_t i = 0; i < n; i++)
+					sum += real_type(values[i]) * real_type(values[i]);
+				const real_type scale = sqrt(sum);
+				for (size_t i = 0; i < n; i++)
+					x[i] = y[i] = real_type(values[i]) / scale;
+				sum = real_type(0);
+				for (size_t j = n; j-- > 0;) {
+					sum += x[j] * x[j];
+					s[j] = sqrt(sum);
+				}
+
+				// H: n x (n - 1), lower trapezoidal
+				for (size_t i = 0; i < n; i++) {
+					for (size_t j = 0; j + 1 < n; j++) {
+						if (i < j)
+							h(i, j) = real_type(0);
+						else if (i == j)
+							h(i, j) = s[j + 1] / s[j];
+						else
+							h(i, j) = -(x[i] * x[j]) / (s[j] * s[j + 1]);
+					}
+					for (size_t j = 0; j < n; j++)
+						b(i, j) = (i == j);
+				}
+				if (!reduce())
+					return false;
+
+				const double bound = double(opts.maxCoefficient) * std::sqrt(double(n));
+				for (int iteration = 0; iteration < opts.maxIterations; iteration++) {
+					// the row with the largest gamma^(m + 1) |H_mm|
+					size_t m = 0;
+					real_type best(-1), weight = gamma;
+					for (size_t j = 0; j + 1 < n; j++, weight = weight * gamma) {
+						real_type v = weight * abs(h(j, j));
+						if (v > best) {
+							best = v;
+							m = j;
+						}
+					}
+
+					std::swap(y[m], y[m + 1]);
+					for (size_t k = 0; k + 1 < n; k++)
+						std::swap(h(m, k), h(m + 1, k));
+					for (size_t k = 0; k < n; k++)
+						std::swap(b(k, m), b(k, m + 1));
+
+					// restore the trapezoidal shape the swap broke at (m, m + 1)
+					if (m + 2 < n) {
+						real_type t0 = sqrt(h(m, m) * h(m, m) + h(m, m + 1) * h(m, m + 1));
+						real_type t1 = h(m, m) / t0, t2 = h(m, m + 1) / t0;
+						for (size_t i = m; i < n; i++) {
+							real_type t3 = h(i, m), t4 = h(i, m + 1);
+							h(i, m) = t1 * t3 + t2 * t4;
+							h(i, m + 1) = t1 * t4 - t2 * t3;
+						}
+					}
+					if (!reduce())
+						return false;
+
+					// a y_j at the tolerance: column j of B is the relation
+					for (size_t j = 0; j < n; j++) {
+						if (double(abs(y[j])) <= opts.tolerance && accept(values, j))
+							return true;
+					}
+
+					// no relation of norm below 1 / max |H_jj| exists
+					real_type largest(0);
+					for (size_t j = 0; j + 1 < n; j++)
+						largest = std::max(largest, abs(h(j, j)), [](const real_type &a, const real_type &b) { return a < b; });
+					if (double(largest) * bound < 1)
+						return false;
+				}
+				return false;
+			}
+
+		// Hermite reduction of H, carried over to y and B; false once B leaves the 64-bit range
+		bool reduce() {
+				for (size_t i = 1; i < n; i++) {
+					for (size_t j = std::min(i, n - 1); j-- > 0;) {
+						real_type t = nearest(h(i, j) / h(j, j));
+						const double td = double(t);
+						if (td == 0)
+							continue;
+						if (!(std::abs(td) < 0x1p62))
+							return false;
+						const int64_t ti = int64_t(td);
+						y[j] += t * y[i];
+						for (size_t k = 0; k <= j; k++)
+							h(i, k) -= t * h(j, k);
+						for (size_t k = 0; k < n; k++) {
+							int64_t v;
+							if (checkedMul(ti, b(k, i), v) || checkedAdd(b(k, j), v, b(k, j)))
+								return false;
+						}
+					}
+				}
+				return true;
+			}
+
+		// column j of B within the coefficient bound and the tolerance, checked in double-double
+		bool accept(std::span<const double> values, size_t j) {
+				int64_t first = 0;
+				for (size_t k = 0; k < n; k++) {
+					int64_t c = b(k, j);
+					if (c > opts.maxCoefficient || c < -opts.maxCoefficient)
+						return false;
+					found[k] = c;
+					if (first == 0)
+						first = c;
+				}
+				if (first == 0)
+					return false;
+				DoubleDouble residual(0), sum(0);
+				for (size_t k = 0; k < n; k++) {
+					residual += DoubleDouble(double(found[k])) * DoubleDouble(values[k]);
+					sum += DoubleDouble(values[k]) * DoubleDouble(values[k]);
+				}
+				if (double(abs(residual)) > opts.tolerance * double(sqrt(sum)))
+					return false;
+				if (first < 0) {
+					for (int64_t &c : found)
+						c = -c;
+				}
+				return true;
+			}
+
+		size_t n;
+		RelationOptions opts;
+		std::vector<real_type> x, y, s, H;
+		std::vector<int64_t> B;
+		std::vector<int64_t> found;
+	};
+}
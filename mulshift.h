@@ -0,0 +1,203 @@
+
+#pragma once
+
+#include "./convert_to_fraction.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+
+namespace cvt_2_fraction
+{
+	/// <summary>
+	/// <para>Multiply-shift approximants: find an integer multiplier m and shift s so that</para>
+	/// <code>
+	///     (x * m + bias) &gt;&gt; s  ~=  x * val        for every integer x in [xmin, xmax]
+	/// </code>
+	/// <para>
+	/// within a given absolute tolerance. This is toFract() restricted to power-of-two denominators
+	/// m / 2^s, but judged by the error over the whole input range instead of the error at val alone:
+	/// the slope error |m / 2^s - val| is multiplied by |x|, and the shift adds its own truncation error.</para>
+	///
+	/// <para>
+	/// With d = m / 2^s - val the error for a given x is e(x) = x*d + r(x), where r(x) is the rounding
+	/// error of the shift: r in [-(1 - 2^-s), 0] for a plain (floor) shift and r in [-1/2 + 2^-s, 1/2] when
+	/// bias = 2^(s-1) is added first (round to nearest). errorLow/errorHigh bound e over the range; the bound
+	/// is rigorous (rounded outwards) and attained up to the granularity of r.</para>
+	///
+	/// <para>
+	/// The bound is computed in integers, in units of 2^-(s + k) where val * 2^s has k fraction bits, and
+	/// only rounded to double at the end. For |val * 2^s| &lt; 2^-97 with m or s nonzero, the fraction bits
+	/// of d are cut at 150 and the bound is widened by the part cut off: m = 1 or -1, or the shift error r
+	/// dwarfs it.</para>
+	/// </summary>
+	enum class ShiftRounding
+	{
+		Floor,          // (x * m) >> s
+		Nearest,        // (x * m + (1 << (s - 1))) >> s
+	};
+
+	enum class ShiftObjective
+	{
+		MinimalShift,
+		MinimalMultiplier,
+	};
+
+	struct MulShift
+	{
+		int64_t multiplier;
+		unsigned shift;
+		int64_t bias;
+		double errorLow;        // e(x) in [errorLow, errorHigh] for all x in range
+		double errorHigh;
+		double maxError;        // max(|errorLow|, |errorHigh|)
+	};
+
+	namespace detail
+	{
+		using ShiftWide = WideInt<4>;
+
+		inline bool productFits(int64_t m, int64_t xmin, int64_t xmax, int64_t bias, unsigned productBits) {
+			// the product is evaluated in a signed type when the range contains negative x, unsigned otherwise
+			const Int128 limit = Int128(1) << int(xmin < 0 ? productBits - 1 : productBits);
+			for (int64_t x : { xmin, xmax }) {
+				const Int128 p = Int128(x) * m + bias;
+				if (p >= limit || (xmin < 0 ? p < -limit : p < 0))
+					return false;
+			}
+			return true;
+		}
+
+		// v * 2^-F rounded down, or up, to a double: the nearest double, moved by one ulp when the exact
+		// comparison puts it on the wrong side of v
+		inline double roundDyadic(const ShiftWide &v, int F, bool up) {
+			double t = std::ldexp(double(v), -F);
+			int e;
+			const int64_t tm = splitDyadic(t, e);
+			const int c = compareScaled<256>(v, ShiftWide(tm), e + F);
+			if (up ? c > 0 : c < 0)
+				t = std::nextafter(t, up ? HUGE_VAL : -HUGE_VAL);
+			return t;
+		}
+
+		inline MulShift evaluateMulShift(double val, int64_t m, unsigned s, int64_t xmin, int64_t xmax, ShiftRounding rounding) {
+			constexpr int MaxFractionBits = 150;
+			MulShift rv{ m, s, 0, 0, 0, 0 };
+
+			// val = V * 2^E; in units of 2^-F, F = s + k, d = m / 2^s - val is D = m * 2^k - V * 2^(E + F)
+			int E;
+			const int64_t V = splitDyadic(val, E);
+			// (m = s = 0: D = -V, no need to cut)
+			const int k = std::clamp(-(E + int(s)), 0, (m == 0 && s == 0 ? std::max(-E, 0) : MaxFractionBits));
+			const int F = int(s) + k;
+			const ShiftWide M = (m == 0 ? ShiftWide(0) : ShiftWide(m) << k);
+			ShiftWide dLow, dHigh;
+			if (E + F >= 0) {
+				dLow = dHigh = M - (ShiftWide(V) << (E + F));                   // |V * 2^(E + F)| < 2^62
+			}
+			else {
+				// V * 2^(E + F) in [Vq, Vq + 1) when bits are cut off (|m| <= 1 then)
+				const int cut = std::min(-(E + F), 63);
+				const ShiftWide Vq = ShiftWide(V >> cut);
+				dHigh = M - Vq;
+				dLow = dHigh - ShiftWide((Vq << cut) != ShiftWide(V) ? 1 : 0);
+			}
+
+			// r in units of 2^-F
+			ShiftWide rLow = 0, rHigh = 0;
+			if (s > 0) {
+				if (rounding == ShiftRounding::Floor) {
+					rLow = -(((ShiftWide(1) << int(s)) - 1) << k);
+				}
+				else {
+					rv.bias = int64_t(1) << (s - 1);
+					rLow = -(((ShiftWide(1) << int(s - 1)) - 1) << k);
+					rHigh = ShiftWide(1) << int(s - 1 + k);
+				}
+			}
+
+			// |x D| < 2^(63 + 151), |r| < 2^(62 + 150): exact in 256 bits
+			ShiftWide lo, hi;
+			bool first = true;
+			for (int64_t x : { xmin, xmax }) {
+				for (const ShiftWide &d : { dLow, dHigh }) {
+					const ShiftWide e = ShiftWide(x) * d;
+					if (first || e < lo)
+						lo = e;
+					if (first || e > hi)
+						hi = e;
+					first = false;
+				}
+			}
+			rv.errorLow = roundDyadic(lo + rLow, F, false);
+			rv.errorHigh = roundDyadic(hi + rHigh, F, true);
+			rv.maxError = std::max(std::abs(rv.errorLow), std::abs(rv.errorHigh));
+			return rv;
+		}
+	}
+
+	/// <summary>
+	/// <para>Find (m, s) for `val` over the integer input range [xmin, xmax] with max |e(x)| &lt;= tolerance.
+	/// The products x*m + bias must fit in `productBits` bits (signed when xmin &lt; 0); s is at most maxShift.</para>
+	///
+	/// <para>MinimalShift returns the smallest s that meets the tolerance (and then the most accurate m);
+	/// MinimalMultiplier the smallest |m| over all admissible s. Returns nullopt when no pair qualifies.</para>
+	/// </summary>
+	inline std::optional<MulShift> findMulShift(double val, int64_t xmin, int64_t xmax, double tolerance,
+		ShiftObjective objective = ShiftObjective::MinimalShift, ShiftRounding rounding = ShiftRounding::Floor,
+		unsigned productBits = 64, unsigned maxShift = 62)
+		{
+			if (!std::isfinite(val))
+				throw std::invalid_argument(std::format("scale factor must be finite, got {}", val));
+			if (xmin > xmax)
+				throw std::invalid_argument(std::format("input range is empty: [{}, {}]", xmin, xmax));
+			if (!(tolerance >= 0))
+				throw std::invalid_argument(std::format("tolerance must be non-negative, got {}", tolerance));
+			if (productBits < 2 || productBits > 64 || maxShift > 62)
+				throw std::invalid_argument(std::format("unsupported product width {} / shift {}", productBits, maxShift));
+
+			std::optional<MulShift> best;
+			for (unsigned s = 0; s <= maxShift; s++) {
+				const double scaled = std::ldexp(val, int(s));
+				if (std::abs(scaled) >= 0x1.0p62)
+					break;
+
+				// for a floor shift the ceiling candidate often wins, as its positive slope error offsets the truncation
+				for (double c : { std::floor(scaled), std::ceil(scaled) }) {
+					int64_t m = int64_t(c);
+					MulShift cand = detail::evaluateMulShift(val, m, s, xmin, xmax, rounding);
+					if (cand.maxError > tolerance || !detail::productFits(m, xmin, xmax, cand.bias, productBits))
+						continue;
+
+					bool better;
+					if (!best)
+						better = true;
+					else if (objective == ShiftObjective::MinimalShift)
+						better = (cand.shift == best->shift && cand.maxError < best->maxError);
+					else
+						better = (std::abs(cand.multiplier) < std::abs(best->multiplier)
+							|| (std::abs(cand.multiplier) == std::abs(best->multiplier) && cand.maxError < best->maxError));
+					if (better)
+						best = cand;
+				}
+
+				if (best && objective == ShiftObjective::MinimalShift)
+					break;
+			}
+
+			if (DebugReporting && best) {
+				detail::debugReport("MulShift: val = {}, range = [{}, {}]: m = {}, s = {}, bias = {}, error in [{}, {}]\n",
+					val, xmin, xmax, best->multiplier, best->shift, best->bias, best->errorLow, best->errorHigh);
+			}
+			return best;
+		}
+
+	/// <summary>
+	/// Apply a multiply-shift approximant; the reference implementation of what the generated constants mean.
+	/// </summary>
+	inline int64_t applyMulShift(int64_t x, const MulShift &ms) {
+			return int64_t((detail::Int128(x) * ms.multiplier + ms.bias) >> int(ms.shift));
+		}
+}
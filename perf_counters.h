@@ -0,0 +1,145 @@
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace cvt_2_fraction
+{
+	/// <summary>
+	/// <para>Hardware performance counters for the benchmark harness: cycles, instructions, branch misses
+	/// and L1D read misses of the calling thread (user space only), read as one group via perf_event_open.</para>
+	///
+	/// <para>
+	/// When the counters cannot be opened (not Linux, perf_event_paranoid, containers without the syscall,
+	/// virtual machines without a PMU) available() is false and only the wall clock time is measured;
+	/// individual events that are missing (e.g. no L1D event on some hosts) read as -1.
+	/// Counts are scaled by time_enabled / time_running when the kernel had to multiplex the group.</para>
+	/// </summary>
+	class PerfCounters
+	{
+	public:
+		enum Event
+		{
+			Cycles,
+			Instructions,
+			BranchMisses,
+			L1DMisses,
+			EventCount
+		};
+
+		static constexpr std::array<std::string_view, EventCount> EventNames = {
+			"cycles", "instructions", "branch-misses", "L1D-misses",
+		};
+
+		struct Sample
+		{
+			double nanoseconds = 0;
+			std::array<double, EventCount> counts = { -1, -1, -1, -1 };
+		};
+
+		explicit PerfCounters(bool enable = true) {
+			fds.fill(-1);
+#if defined(__linux__)
+			if (!enable)
+				return;
+
+			const uint64_t configs[EventCount][2] = {
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+				{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+			};
+			for (int i = 0; i < EventCount; i++) {
+				perf_event_attr attr;
+				std::memset(&attr, 0, sizeof(attr));
+				attr.size = sizeof(attr);
+				attr.type = uint32_t(configs[i][0]);
+				attr.config = configs[i][1];
+				attr.disabled = (leader < 0);
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+				int fd = int(::syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+				if (fd < 0) {
+					// without cycles there is no group to hang the others on: fall back to wall clock only
+					if (i == Cycles)
+						return;
+					continue;
+				}
+				if (leader < 0)
+					leader = fd;
+				fds[i] = fd;
+				::ioctl(fd, PERF_EVENT_IOC_ID, &ids[i]);
+			}
+#else
+			(void)enable;
+#endif
+		}
+
+		PerfCounters(const PerfCounters &) = delete;
+		PerfCounters &operator=(const PerfCounters &) = delete;
+
+		~PerfCounters() {
+#if defined(__linux__)
+			for (int fd : fds) {
+				if (fd >= 0)
+					::close(fd);
+			}
+#endif
+		}
+
+		bool available() const { return leader >= 0; }
+
+		void start() {
+#if defined(__linux__)
+			if (available()) {
+				::ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+				::ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+			}
+#endif
+			t0 = std::chrono::steady_clock::now();
+		}
+
+		Sample stop() {
+			auto t1 = std::chrono::steady_clock::now();
+			Sample rv;
+#if defined(__linux__)
+			if (available()) {
+				::ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+				// { nr, time_enabled, time_running, { value, id } * nr }
+				uint64_t buf[3 + 2 * EventCount] = {};
+				if (::read(leader, buf, sizeof(buf)) > 0) {
+					const double scale = (buf[2] ? double(buf[1]) / double(buf[2]) : 1.0);
+					for (uint64_t k = 0; k < buf[0] && k < EventCount; k++) {
+						for (int i = 0; i < EventCount; i++) {
+							if (fds[i] >= 0 && ids[i] == buf[3 + 2 * k + 1])
+								rv.counts[i] = double(buf[3 + 2 * k]) * scale;
+						}
+					}
+				}
+			}
+#endif
+			rv.nanoseconds = double(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+			return rv;
+		}
+
+	private:
+		int leader = -1;
+		std::array<int, EventCount> fds;
+		std::array<uint64_t, EventCount> ids = {};
+		std::chrono::steady_clock::time_point t0;
+	};
+}
@@ -0,0 +1,207 @@
+
+#pragma once
+
+#include "./convert_to_fraction.h"
+
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace cvt_2_fraction
+{
+	enum class ScaleRounding
+	{
+		Floor,
+		Nearest,        // round half up, i.e. floor(x * num / den + 1/2)
+		Ceil,
+	};
+
+	/// <summary>
+	/// <para>A fraction prepared for applying x * num / den to large arrays of int32 values without a
+	/// hardware divide: the denominator is turned into a libdivide-style magic reciprocal once, after
+	/// which every quotient costs a multiply-high, a shift and a compare.</para>
+	///
+	/// <para>
+	/// The input is biased into an unsigned value u (u = x ^ 0x80000000, or its complement when num &lt; 0)
+	/// so that all arithmetic is unsigned:</para>
+	/// <code>
+	///     x * num + c  ==  u * |num| - D,         D = K * |num| - c,  K = 2^31 (num &gt; 0) or 2^31 - 1 (num &lt; 0)
+	///
+	///     floor((u * |num| - D) / den)  ==  qA - Dq - (rA &lt; Dr ? 1 : 0)
+	/// </code>
+	/// <para>
+	/// where qA, rA = divmod(u * |num|, den) come from the magic reciprocal and Dq, Dr = divmod(D, den) are
+	/// precomputed per rounding mode (c = 0 for floor, den / 2 for nearest, den - 1 for ceil).</para>
+	///
+	/// <para>Requires |num| &lt; 2^32 and 0 &lt; den &lt; 2^31; the results are exact for every int32 input.</para>
+	/// </summary>
+	template<typename int_type>
+	class PreparedFraction
+	{
+	public:
+		explicit PreparedFraction(const Fraction<int_type> &frac)
+			: num(int64_t(frac.numerator())), den(uint64_t(frac.denominator()))
+			{
+				if (frac.denominator() <= 0 || uint64_t(frac.denominator()) >= (uint64_t(1) << 31))
+					throw std::invalid_argument(std::format("PreparedFraction: denominator {} out of range", frac.denominator()));
+				if (num > 0xFFFFFFFFLL || num < -0xFFFFFFFFLL)
+					throw std::invalid_argument(std::format("PreparedFraction: numerator {} out of range", frac.numerator()));
+
+				absNum = uint64_t(num < 0 ? -num : num);
+				flip = (num < 0 ? 0xFFFFFFFFu : 0u);
+
+				// libdivide's u64 algorithm: magic = ceil(2^(64 + k) / den) minus the implicit 65th bit when needed
+				const unsigned k = 63 - unsigned(std::countl_zero(den));
+				pow2 = ((den & (den - 1)) == 0);
+				if (pow2) {
+					magic = 0;
+					shift = k;
+					addMarker = false;
+				}
+				else {
+					uint64_t rem;
+					uint64_t proposed = detail::divMod(detail::WideInt<2>(1) << int(64 + k), den, rem).w[0];
+					uint64_t e = den - rem;
+					if (e < (uint64_t(1) << k)) {
+						addMarker = false;
+					}
+					else {
+						proposed += proposed;
+						uint64_t twiceRem = rem + rem;
+						if (twiceRem >= den || twiceRem < rem)
+							proposed += 1;
+						addMarker = true;
+					}
+					magic = proposed + 1;
+					shift = k;
+				}
+
+				const uint64_t K = (num < 0 ? (uint64_t(1) << 31) - 1 : (uint64_t(1) << 31));
+				const uint64_t c[3] = { 0, den / 2, den - 1 };
+				for (int mode = 0; mode < 3; mode++) {
+					uint64_t D = K * absNum - c[mode];
+					Dq[mode] = int64_t(D / den);
+					Dr[mode] = int64_t(D % den);
+				}
+			}
+
+		int64_t numerator() const { return num; }
+		int64_t denominator() const { return int64_t(den); }
+
+		/// <summary>
+		/// floor(n / den) for any 64-bit n, without a divide instruction.
+		/// </summary>
+		uint64_t divide(uint64_t n) const {
+				if (pow2)
+					return n >> shift;
+				uint64_t q;
+				detail::mulWide(magic, n, q);
+				if (addMarker)
+					return (((n - q) >> 1) + q) >> shift;
+				return q >> shift;
+			}
+
+		int64_t apply(int32_t x, ScaleRounding rounding = ScaleRounding::Floor) const {
+				if (num == 0)
+					return 0;
+				const int mode = int(rounding);
+				uint64_t u = uint32_t(x) ^ 0x80000000u ^ flip;
+				uint64_t a = u * absNum;
+				uint64_t q = divide(a);
+				uint64_t r = a - q * den;
+				// q may exceed INT64_MAX when den is small; the wrapped difference is still the exact result
+				return int64_t(q - uint64_t(Dq[mode]) - (int64_t(r) < Dr[mode] ? 1 : 0));
+			}
+
+		/// <summary>
+		/// out[i] = round(in[i] * num / den) per `rounding`; `out` must be at least as large as `in`.
+		/// Uses AVX2 (4 lanes of 64-bit multiply-high emulated with 32x32 multiplies, as libdivide does)
+		/// when compiled for it, and the scalar division-free path otherwise and for the tail.
+		/// </summary>
+		void apply(std::span<const int32_t> in, std::span<int64_t> out, ScaleRounding rounding = ScaleRounding::Floor) const {
+				assert(out.size() >= in.size());
+				size_t i = 0;
+				if (num == 0) {
+					for (; i < in.size(); i++)
+						out[i] = 0;
+					return;
+				}
+#if defined(__AVX2__)
+				i = applyAVX2(in, out, int(rounding));
+#endif
+				for (; i < in.size(); i++)
+					out[i] = apply(in[i], rounding);
+			}
+
+	private:
+#if defined(__AVX2__)
+		static __m256i mullhi_u64(__m256i x, __m256i y) {
+				const __m256i lomask = _mm256_set1_epi64x(0xFFFFFFFF);
+				__m256i xh = _mm256_srli_epi64(x, 32);
+				__m256i yh = _mm256_srli_epi64(y, 32);
+				__m256i w0 = _mm256_mul_epu32(x, y);
+				__m256i w1 = _mm256_mul_epu32(x, yh);
+				__m256i w2 = _mm256_mul_epu32(xh, y);
+				__m256i w3 = _mm256_mul_epu32(xh, yh);
+				__m256i s1 = _mm256_add_epi64(w1, _mm256_srli_epi64(w0, 32));
+				__m256i s2 = _mm256_add_epi64(w2, _mm256_and_si256(s1, lomask));
+				return _mm256_add_epi64(_mm256_add_epi64(w3, _mm256_srli_epi64(s1, 32)), _mm256_srli_epi64(s2, 32));
+			}
+
+		size_t applyAVX2(std::span<const int32_t> in, std::span<int64_t> out, int mode) const {
+				const __m128i bias = _mm_set1_epi32(int32_t(0x80000000u ^ flip));
+				const __m256i vnum = _mm256_set1_epi64x(int64_t(absNum));
+				const __m256i vden = _mm256_set1_epi64x(int64_t(den));
+				const __m256i vmagic = _mm256_set1_epi64x(int64_t(magic));
+				const __m128i vshift = _mm_cvtsi32_si128(int(shift));
+				const __m256i vDq = _mm256_set1_epi64x(Dq[mode]);
+				const __m256i vDr = _mm256_set1_epi64x(Dr[mode]);
+
+				size_t i = 0;
+				for (; i + 4 <= in.size(); i += 4) {
+					__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in.data() + i));
+					__m256i u = _mm256_cvtepu32_epi64(_mm_xor_si128(x, bias));
+					__m256i a = _mm256_mul_epu32(u, vnum);
+
+					__m256i q;
+					if (pow2) {
+						q = _mm256_srl_epi64(a, vshift);
+					}
+					else {
+						q = mullhi_u64(vmagic, a);
+						if (addMarker)
+							q = _mm256_add_epi64(_mm256_srli_epi64(_mm256_sub_epi64(a, q), 1), q);
+						q = _mm256_srl_epi64(q, vshift);
+					}
+
+					// r = a - q * den; den < 2^31 so q * den needs two 32x32 products
+					__m256i qd = _mm256_add_epi64(_mm256_mul_epu32(q, vden),
+						_mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(q, 32), vden), 32));
+					__m256i r = _mm256_sub_epi64(a, qd);
+
+					// r, Dr < 2^31: a signed compare is fine; the mask is -1 where r < Dr
+					__m256i borrow = _mm256_cmpgt_epi64(vDr, r);
+					__m256i res = _mm256_add_epi64(_mm256_sub_epi64(q, vDq), borrow);
+					_mm256_storeu_si256(reinterpret_cast<__m256i *>(out.data() + i), res);
+				}
+				return i;
+			}
+#endif
+
+		int64_t num;
+		uint64_t den;
+		uint64_t absNum;
+		uint32_t flip;
+		uint64_t magic;
+		unsigned shift;
+		bool pow2;
+		bool addMarker;
+		int64_t Dq[3];
+		int64_t Dr[3];
+	};
+}
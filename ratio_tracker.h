@@ -0,0 +1,111 @@
+
+#pragma once
+
+#include "./convert_to_fraction.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace cvt_2_fraction
+{
+	/// <summary>
+	/// <para>Follows a stream of measured ratios (the wind ratio of a winder, the gear ratio of a drive)
+	/// and holds the fraction toFract() chose for it, converting again only when a sample leaves the band
+	/// in which that fraction was accepted.</para>
+	///
+	/// <para>
+	/// After every conversion the band is the bracket the descent ended in, narrowed to the values the
+	/// held fraction p/q approximates within Precision (toFract's criterion |q val - p| &lt; Precision),
+	/// then widened on both sides by hysteresis * Precision / q. The held fraction is itself an end of
+	/// the bracket, so on that side the band reaches p/q +- Precision / q instead: samples just past the
+	/// fraction convert to it again and need no new descent. Checking a sample is two compares
+	/// against the band ends; no multiplication is needed at all. The widening keeps a ratio that
+	/// hovers around the border of two neighbouring fractions from flapping between them, at the cost of
+	/// letting the held fraction's error reach (1 + hysteresis) * Precision before it is replaced.</para>
+	/// </summary>
+	template<typename int_type>
+	class RatioTracker
+	{
+	public:
+		explicit RatioTracker(double Precision, double hysteresis = 0.5)
+			: precision(Precision), hysteresis(hysteresis)
+			{
+				if (!(Precision > 0) || !(hysteresis >= 0))
+					throw std::invalid_argument(std::format("RatioTracker: invalid precision {} / hysteresis {}", Precision, hysteresis));
+			}
+
+		/// <summary>
+		/// Feed one sample; returns the fraction now held.
+		/// </summary>
+		const Fraction<int_type> &update(double val) {
+				changed_ = false;
+				if (val >= bandLow && val <= bandHigh)
+					return current;
+				if (!std::isfinite(val))
+					throw std::invalid_argument(std::format("RatioTracker: cannot track {}", val));
+
+				FractionBracket<int_type> bracket;
+				Fraction<int_type> f = toFract<int_type>(val, precision, &bracket);
+				double q = double(f.denominator());
+				double center = toFloat(f);
+				double lo = center - precision / q;
+				double hi = center + precision / q;
+				if (f != bracket.low)
+					lo = std::max(lo, toFloat(bracket.low));
+				if (f != bracket.high)
+					hi = std::min(hi, toFloat(bracket.high));
+				double margin = hysteresis * precision / q;
+				lo = std::min(lo, val) - margin;
+				hi = std::max(hi, val) + margin;
+
+				changed_ = (conversions_ == 0 || f != current);
+				current = f;
+				bandLow = lo;
+				bandHigh = hi;
+				conversions_++;
+
+				if (DebugReporting) {
+					detail::debugReport("RatioTracker: val = {}: {} accepted in [{}, {}]\n", val, current, bandLow, bandHigh);
+				}
+				return current;
+			}
+
+		const Fraction<int_type> &value() const { return current; }
+
+		/// <summary>
+		/// Whether the last update() replaced the held fraction.
+		/// </summary>
+		bool changed() const { return changed_; }
+
+		/// <summary>
+		/// The band of samples that keep the held fraction.
+		/// </summary>
+		double lower() const { return bandLow; }
+		double upper() const { return bandHigh; }
+
+		/// <summary>
+		/// How many samples needed a toFract() descent.
+		/// </summary>
+		size_t conversions() const { return conversions_; }
+
+		/// <summary>
+		/// Drop the held fraction: the next sample is converted unconditionally.
+		/// </summary>
+		void reset() {
+				bandLow = 1;
+				bandHigh = 0;
+				conversions_ = 0;
+				changed_ = false;
+			}
+
+	private:
+		double precision;
+		double hysteresis;
+		Fraction<int_type> current;
+		double bandLow = 1;     // empty until the first conversion
+		double bandHigh = 0;
+		size_t conversions_ = 0;
+		bool changed_ = false;
+	};
+}
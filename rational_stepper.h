@@ -0,0 +1,126 @@
+
+#pragma once
+
+#include "./convert_to_fraction.h"
+
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+
+namespace cvt_2_fraction
+{
+	/// <summary>
+	/// <para>Bresenham-style DDA over a fraction: produces the sequence</para>
+	/// <code>
+	///     v(i) = floor((i * num + phase) / den),     i = start, start + 1, ...
+	/// </code>
+	/// <para>
+	/// with one division at construction and only additions and a compare per step. phase = 0 gives the
+	/// plain floor sequence (pixel resampling source indices, Dar-style aspect scaling), phase = den / 2
+	/// rounds to nearest.</para>
+	///
+	/// <para>
+	/// For 0 &lt;= num &lt;= den the per-step increment is 0 or 1, and step() reporting whether v increased
+	/// distributes num events as evenly as possible over den slots: a rational clock divider, or the
+	/// Euclidean rhythm E(num, den).</para>
+	/// </summary>
+	template<typename int_type>
+	class RationalStepper
+	{
+	public:
+		explicit RationalStepper(const Fraction<int_type> &frac, int_type start = 0, int_type phase = 0)
+			: den(frac.denominator())
+			{
+				// floor division: the remainders are kept in [0, den) for negative values too
+				floorDivMod(frac.numerator(), den, stepQ, stepR);
+
+				int_type sq, sr, pq, pr;
+				floorDivMod(start, den, sq, sr);
+				floorDivMod(phase, den, pq, pr);
+				// start * num + phase == (sq * den + sr) * num + phase; sr * num stays below den * |num|
+				int_type t, tq, tr;
+				if (checkedMul(sr, frac.numerator(), t))
+					throw std::invalid_argument(std::format("RationalStepper: {} * {} overflows", sr, frac.numerator()));
+				floorDivMod(t, den, tq, tr);
+				value_ = sq * frac.numerator() + tq + pq;
+				rem = addRemainder(tr, pr, value_);
+			}
+
+		/// <summary>
+		/// The current value v(i).
+		/// </summary>
+		int_type value() const { return value_; }
+
+		/// <summary>
+		/// Advance to i + 1; returns the increment v(i + 1) - v(i).
+		/// </summary>
+		int_type step() {
+				int_type inc = stepQ;
+				rem = addRemainder(rem, stepR, inc);
+				value_ += inc;
+				return inc;
+			}
+
+		/// <summary>
+		/// Return v(i) and advance.
+		/// </summary>
+		int_type next() {
+				int_type rv = value_;
+				step();
+				return rv;
+			}
+
+	private:
+		// (r + add) mod den for r, add in [0, den), carrying into `q`; r + add itself may not fit past
+		// den > MaxValue / 2, so the carry is decided against den - add
+		int_type addRemainder(int_type r, int_type add, int_type &q) const {
+				if (r >= den - add) {
+					q++;
+					return r - (den - add);
+				}
+				return r + add;
+			}
+
+		static void floorDivMod(int_type a, int_type b, int_type &q, int_type &r) {
+				q = a / b;
+				r = a % b;
+				if (r < 0) {
+					r += b;
+					q--;
+				}
+			}
+
+		int_type den;
+		int_type stepQ;
+		int_type stepR;
+		int_type value_;
+		int_type rem;
+	};
+
+	/// <summary>
+	/// out[k] = floor(((start + k) * num + phase) / den) for all k.
+	/// </summary>
+	template<typename int_type>
+	void fillSteps(const Fraction<int_type> &frac, std::span<int_type> out, int_type start = 0, int_type phase = 0)
+		{
+			RationalStepper<int_type> dda(frac, start, phase);
+			for (int_type &v : out)
+				v = dda.next();
+		}
+
+	/// <summary>
+	/// Distribute num events over den slots (requires 0 &lt;= num &lt;= den): out[k] = 1 when slot k fires.
+	/// Successive calls can be continued via `start`; the pattern repeats every den slots.
+	/// </summary>
+	template<typename int_type>
+	void fillPattern(const Fraction<int_type> &frac, std::span<uint8_t> out, int_type start = 0)
+		{
+			if (frac.numerator() < 0 || frac.numerator() > frac.denominator())
+				throw std::invalid_argument(std::format("fillPattern: {} is not in [0, 1]", frac));
+
+			// slot k fires when floor((k + 1) * num / den) > floor(k * num / den)
+			RationalStepper<int_type> dda(frac, start);
+			for (uint8_t &v : out)
+				v = uint8_t(dda.step());
+		}
+}
@@ -0,0 +1,218 @@
+
+#pragma once
+
+#include "./convert_to_fraction.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace cvt_2_fraction
+{
+	/// <summary>
+	/// The closest fraction to `exact` whose numerator and denominator are both in [1, limit]: the last
+	/// convergent that fits, or the best semiconvergent past it. `exact` must be positive.
+	/// </summary>
+	inline Fraction<int64_t> boundedFraction(const Fraction<int64_t> &exact, int64_t limit)
+		{
+			if (exact.numerator() <= 0 || limit < 1)
+				throw std::invalid_argument(std::format("boundedFraction: cannot bound {} by {}", exact, limit));
+
+			// |p/q - a/b| as the pair (|p b - a q|, q b), compared by cross products
+			auto closer = [&exact](int64_t p1, int64_t q1, int64_t p2, int64_t q2) {
+				const detail::Int128 a = exact.numerator(), b = exact.denominator();
+				detail::Int128 e1 = p1 * b - a * q1, e2 = p2 * b - a * q2;
+				if (e1 < 0) e1 = -e1;
+				if (e2 < 0) e2 = -e2;
+				return e1 * q2 < e2 * q1;
+			};
+
+			int64_t num = exact.numerator(), den = exact.denominator();
+			int64_t h2 = 0, k2 = 1, h1 = 1, k1 = 0;    // the convergents before last and last
+			bool first = true;
+			for (;;) {
+				int64_t t = num / den;
+				// the largest j <= t with h2 + j h1 and k2 + j k1 within limit
+				int64_t j = t;
+				if (h1 > 0)
+					j = std::min(j, (limit - h2) / h1);
+				if (k1 > 0)
+					j = std::min(j, (limit - k2) / k1);
+				if (j < t) {
+					if (first)
+						return Fraction<int64_t>(limit, 1);             // beyond limit / 1
+					if (h1 == 0)
+						return Fraction<int64_t>(1, limit);             // below 1 / limit
+					if (j >= 1 && closer(h2 + j * h1, k2 + j * k1, h1, k1))
+						return Fraction<int64_t>(h2 + j * h1, k2 + j * k1);
+					return Fraction<int64_t>(h1, k1);
+				}
+				int64_t h = h2 + t * h1, k = k2 + t * k1;
+				h2 = h1; k2 = k1;
+				h1 = h; k1 = k;
+				first = false;
+
+				int64_t r = num - t * den;
+				if (r == 0)
+					return h1 > 0 ? Fraction<int64_t>(h1, k1) : Fraction<int64_t>(1, limit);
+				num = den;
+				den = r;
+			}
+		}
+
+	enum class PixelAspect
+	{
+		Anamorphic,     // keep the source's storage shape, the SAR makes up the display aspect
+		Square,         // SAR 1:1, the output dimensions carry the display aspect alone
+	};
+
+	struct SarConstraints
+	{
+		int64_t widthMultiple = 2;      // output width / height alignment, e.g. 2, 8 or 16
+		int64_t heightMultiple = 2;
+		int64_t maxWidth = 0;           // 0: no limit
+		int64_t maxHeight = 0;
+		int64_t maxSarTerm = 65535;     // largest SAR numerator / denominator the encoder accepts
+		PixelAspect pixels = PixelAspect::Anamorphic;
+		int search = 2;                 // aligned widths tried on each side of the ideal one
+	};
+
+	struct SarPlan
+	{
+		int64_t width;
+		int64_t height;
+		Fraction<int64_t> sar;
+		double aspectError;             // |displayed aspect / target aspect - 1|
+		double shapeError;              // |(width / height) / ideal shape - 1|: the stretch the resize adds
+	};
+
+	/// <summary>
+	/// <para>Encoder-friendly output sizes and SAR (sample aspect ratio) for showing a width x height
+	/// source at display aspect `dar`. The output is aligned to the constraint multiples and kept within
+	/// the maximum dimensions, and the SAR is DAR * height / width, reduced and, where its terms exceed
+	/// maxSarTerm (encoders such as x264 clamp sarX / sarY), replaced by the closest fraction that fits.</para>
+	///
+	/// <para>
+	/// Rather than scanning every width and height, the ideal size for a rung is computed directly (its
+	/// target height, capped so that the width fits): only the aligned heights on either side of it and
+	/// the `search` aligned widths on each side of the ideal shape are tried, each settled with one bounded
+	/// continued fraction expansion. Plans are ranked by aspect error, then by distance from the target
+	/// height, then by shape error.</para>
+	///
+	/// <para>
+	/// Source sizes, the DAR terms, maxSarTerm and the alignment multiples must be below 2^31, and output
+	/// sizes of 2^31 or more are never proposed (a plan() left without candidates throws), which keeps
+	/// every product exact.</para>
+	/// </summary>
+	class SarPlanner
+	{
+	public:
+		SarPlanner(int64_t width, int64_t height, const Fraction<int64_t> &dar, const SarConstraints &constraints = {})
+			: dar(dar), limits(constraints)
+			{
+				if (width <= 0 || height <= 0)
+					throw std::invalid_argument(std::format("SarPlanner: invalid source size {}x{}", width, height));
+				if (width >= Limit || height >= Limit)
+					throw std::invalid_argument(std::format("SarPlanner: source size {}x{} is too large", width, height));
+				if (dar.numerator() <= 0 || dar.numerator() >= Limit || dar.denominator() >= Limit)
+					throw std::invalid_argument(std::format("SarPlanner: invalid display aspect {}", dar));
+				if (limits.widthMultiple < 1 || limits.heightMultiple < 1 || limits.widthMultiple >= Limit || limits.heightMultiple >= Limit)
+					throw std::invalid_argument(std::format("SarPlanner: invalid alignment {}x{}", limits.widthMultiple, limits.heightMultiple));
+				if (limits.maxWidth < 0 || limits.maxHeight < 0 || limits.maxSarTerm < 1 || limits.maxSarTerm >= Limit || limits.search < 1)
+					throw std::invalid_argument("SarPlanner: invalid constraints");
+
+				// the output shape (width / height) aimed for
+				shapeValue = (limits.pixels == PixelAspect::Square ? toFloat(dar) : double(width) / double(height));
+			}
+
+		/// <summary>
+		/// The candidate plans for an output of (about) targetHeight lines, best first.
+		/// </summary>
+		std::vector<SarPlan> plan(int64_t targetHeight) const {
+				if (targetHeight <= 0 || targetHeight >= Limit)
+					throw std::invalid_argument(std::format("SarPlanner: invalid target height {}", targetHeight));
+
+				// cap the rung so that its ideal width fits
+				double ideal = double(targetHeight);
+				if (limits.maxHeight > 0)
+					ideal = std::min(ideal, double(limits.maxHeight));
+				if (limits.maxWidth > 0)
+					ideal = std::min(ideal, double(limits.maxWidth) / shapeValue);
+
+				std::vector<SarPlan> rv;
+				const int64_t target = int64_t(ideal);
+				const int64_t hBase = alignDown(target, limits.heightMultiple);
+				for (int64_t h : { hBase, hBase + limits.heightMultiple }) {
+					if (h <= 0 || h >= Limit || (limits.maxHeight > 0 && h > limits.maxHeight) || (h != hBase && hBase == target))
+						continue;
+					const int64_t wBase = alignDown(int64_t(double(h) * shapeValue), limits.widthMultiple);
+					for (int64_t j = -limits.search + 1; j <= limits.search; j++) {
+						int64_t w = wBase + j * limits.widthMultiple;
+						if (w <= 0 || w >= Limit || (limits.maxWidth > 0 && w > limits.maxWidth))
+							continue;
+						rv.push_back(evaluate(w, h));
+					}
+				}
+				if (rv.empty())
+					throw std::invalid_argument(std::format("SarPlanner: no aligned size fits {} lines", targetHeight));
+
+				std::stable_sort(rv.begin(), rv.end(), [&](const SarPlan &a, const SarPlan &b) {
+					if (a.aspectError != b.aspectError)
+						return a.aspectError < b.aspectError;
+					int64_t da = std::abs(a.height - target), db = std::abs(b.height - target);
+					if (da != db)
+						return da < db;
+					return a.shapeError < b.shapeError;
+				});
+				return rv;
+			}
+
+		/// <summary>
+		/// The best plan for every rung of an ABR ladder, given by target height.
+		/// </summary>
+		void planLadder(std::span<const int64_t> targetHeights, std::span<SarPlan> out) const {
+				if (out.size() < targetHeights.size())
+					throw std::invalid_argument(std::format("SarPlanner: {} plans for {} rungs", out.size(), targetHeights.size()));
+				for (size_t i = 0; i < targetHeights.size(); i++)
+					out[i] = plan(targetHeights[i]).front();
+			}
+
+		std::vector<SarPlan> planLadder(std::span<const int64_t> targetHeights) const {
+				std::vector<SarPlan> rv(targetHeights.size());
+				planLadder(targetHeights, rv);
+				return rv;
+			}
+
+	private:
+		static int64_t alignDown(int64_t v, int64_t multiple) {
+				return v / multiple * multiple;
+			}
+
+		SarPlan evaluate(int64_t w, int64_t h) const {
+				Fraction<int64_t> sar(1);
+				if (limits.pixels == PixelAspect::Anamorphic) {
+					// SAR = DAR * h / w: both terms are below 2^62 as w, h < 2^31
+					Fraction<int64_t> exact(dar.numerator() * h, dar.denominator() * w);
+					sar = (exact.numerator() <= limits.maxSarTerm && exact.denominator() <= limits.maxSarTerm
+						? exact : boundedFraction(exact, limits.maxSarTerm));
+				}
+
+				// displayed aspect (w sar) / h against dar, from the exact difference so that plans meeting
+				// it exactly tie at 0; and the stretch of w / h against the ideal shape
+				const detail::Int128 shown = detail::Int128(w * sar.numerator()) * dar.denominator();
+				const detail::Int128 wanted = detail::Int128(h * sar.denominator()) * dar.numerator();
+				double aspectError = double(shown > wanted ? shown - wanted : wanted - shown) / double(wanted);
+				return SarPlan{ w, h, sar, aspectError, std::abs(double(w) / double(h) / shapeValue - 1.0) };
+			}
+
+		static constexpr int64_t Limit = int64_t(1) << 31;
+
+		Fraction<int64_t> dar;
+		SarConstraints limits;
+		double shapeValue;
+	};
+}
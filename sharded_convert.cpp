@@ -0,0 +1,79 @@
+
+#include "./sharded_convert.h"
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace cvt_2_fraction;
+
+
+namespace
+{
+	void Usage(const char *argv0)
+	{
+		std::cerr << std::format(
+			"Usage: {} [options] INPUT OUTPUT\n"
+			"\n"
+			"Converts INPUT (one value per line) to fixed-size fraction records in OUTPUT.\n"
+			"\n"
+			"  --workers N        number of shards/workers (default: hardware concurrency)\n"
+			"  --threads          run workers as in-process threads instead of forked processes (always on non-POSIX systems)\n"
+			"  --binary           write 16-byte int64 num/den records instead of {}-byte text lines\n"
+			"  --precision P      toFract precision (default: 1E-9)\n"
+			"  --int32            convert with int32_t instead of int64_t\n"
+			"  --retries R        re-run a failed shard up to R times (default: 1)\n",
+			argv0, sharded::TextRecordWidth);
+	}
+}
+
+
+#if defined(BUILD_MONOLITHIC)
+#define main cvt2frac_sharded_convert_main
+#endif
+
+extern "C"
+int main(int argc, const char **argv) {
+	sharded::Options opts;
+	bool int32 = false;
+	std::vector<std::string> files;
+
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg = argv[i];
+		if (arg == "--threads")
+			opts.mode = sharded::WorkerMode::Threads;
+		else if (arg == "--binary")
+			opts.binary = true;
+		else if (arg == "--int32")
+			int32 = true;
+		else if (arg == "--workers" && i + 1 < argc)
+			opts.workers = unsigned(std::strtoul(argv[++i], nullptr, 0));
+		else if (arg == "--precision" && i + 1 < argc)
+			opts.precision = std::strtod(argv[++i], nullptr);
+		else if (arg == "--retries" && i + 1 < argc)
+			opts.retries = unsigned(std::strtoul(argv[++i], nullptr, 0));
+		else if (!arg.empty() && arg[0] != '-')
+			files.emplace_back(arg);
+		else {
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+	if (files.size() != 2) {
+		Usage(argv[0]);
+		return 1;
+	}
+
+	try {
+		sharded::Result rv = int32
+			? sharded::convertFile<int32_t>(files[0], files[1], opts)
+			: sharded::convertFile<int64_t>(files[0], files[1], opts);
+		for (size_t shard : rv.failedShards)
+			std::cerr << std::format("shard {} failed; all of its records are marked as errors\n", shard);
+		std::cerr << std::format("{} records written to {}\n", rv.records, files[1]);
+		return rv.failedShards.empty() ? 0 : 2;
+	}
+	catch (const std::exception &ex) {
+		std::cerr << ex.what() << std::endl;
+		return 1;
+	}
+}
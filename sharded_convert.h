@@ -0,0 +1,386 @@
+
+#pragma once
+
+#include "./convert_to_fraction.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <charconv>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <stdexcept>
+
+// mmap and forked workers where the platform has them; elsewhere the files are read and written whole
+// and WorkerMode::Processes falls back to threads
+#if defined(__unix__) || defined(__APPLE__)
+#define CVT2FRAC_SHARDED_POSIX 1
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#else
+#define CVT2FRAC_SHARDED_POSIX 0
+#endif
+
+namespace cvt_2_fraction
+{
+	/// <summary>
+	/// <para>Sharded conversion of large text files (one value per line) to fractions.</para>
+	///
+	/// <para>
+	/// The input is mmapped and cut into shards at line boundaries. Every input line maps to one
+	/// fixed-size output record, so each shard's output offset is known up front: workers write straight
+	/// into a shared mmapped output file and there is no merge step. Workers are either forked processes
+	/// (a crashing shard cannot take down the job; it is reported and can be retried) or in-process threads.
+	/// Without POSIX (mmap, fork) the files are read and written whole and the workers are always threads.</para>
+	///
+	/// <para>
+	/// Text records are "num/den" left aligned and padded with spaces to RecordWidth - 1 characters plus '\n',
+	/// so the output is still a valid line-oriented text file. Binary records are two native int64 values.
+	/// Lines that fail to parse or convert produce an "error" text record, or {0, 0} in binary mode. A shard
+	/// that fails (crashes, possibly midway) has all of its records rewritten as such by the parent.</para>
+	///
+	/// <para>
+	/// Workers mute the DebugReporting output: with N of them converting in bulk, the interleaved
+	/// per-record diagnostics would dominate the run time.</para>
+	/// </summary>
+	namespace sharded
+	{
+		constexpr size_t TextRecordWidth = 42;      // 2 * 20 chars for int64 incl. sign, '/', '\n'
+		constexpr size_t BinaryRecordWidth = 2 * sizeof(int64_t);
+
+		enum class WorkerMode
+		{
+			Processes,
+			Threads,
+		};
+
+		struct Options
+		{
+			unsigned workers = 0;                   // 0: std::thread::hardware_concurrency()
+			WorkerMode mode = WorkerMode::Processes;
+			bool binary = false;
+			double precision = 1E-9;
+			unsigned retries = 1;                   // re-run a failed shard this many times (process mode)
+		};
+
+		struct Shard
+		{
+			size_t begin;           // byte range in the input
+			size_t end;
+			size_t firstRecord;     // index of the first output record
+			size_t records;
+		};
+
+		struct Result
+		{
+			size_t records = 0;
+			std::vector<size_t> failedShards;       // indices into the shard plan; their records are all errors
+		};
+
+#if CVT2FRAC_SHARDED_POSIX
+		class MappedFile
+		{
+		public:
+			MappedFile() = default;
+			MappedFile(const MappedFile &) = delete;
+			MappedFile &operator=(const MappedFile &) = delete;
+
+			~MappedFile() {
+				if (data_ && size_)
+					::munmap(data_, size_);
+				if (fd_ >= 0)
+					::close(fd_);
+			}
+
+			static void openRead(MappedFile &f, const std::string &path) {
+				f.fd_ = ::open(path.c_str(), O_RDONLY);
+				if (f.fd_ < 0)
+					throw std::system_error(errno, std::generic_category(), std::format("cannot open {}", path));
+				struct stat st;
+				if (::fstat(f.fd_, &st) != 0)
+					throw std::system_error(errno, std::generic_category(), std::format("cannot stat {}", path));
+				f.size_ = size_t(st.st_size);
+				if (f.size_) {
+					void *p = ::mmap(nullptr, f.size_, PROT_READ, MAP_PRIVATE, f.fd_, 0);
+					if (p == MAP_FAILED)
+						throw std::system_error(errno, std::generic_category(), std::format("cannot mmap {}", path));
+					f.data_ = static_cast<char *>(p);
+					::madvise(p, f.size_, MADV_SEQUENTIAL);
+				}
+			}
+
+			static void createShared(MappedFile &f, const std::string &path, size_t size) {
+				f.fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+				if (f.fd_ < 0)
+					throw std::system_error(errno, std::generic_category(), std::format("cannot create {}", path));
+				if (::ftruncate(f.fd_, off_t(size)) != 0)
+					throw std::system_error(errno, std::generic_category(), std::format("cannot resize {}", path));
+				f.size_ = size;
+				if (f.size_) {
+					void *p = ::mmap(nullptr, f.size_, PROT_READ | PROT_WRITE, MAP_SHARED, f.fd_, 0);
+					if (p == MAP_FAILED)
+						throw std::system_error(errno, std::generic_category(), std::format("cannot mmap {}", path));
+					f.data_ = static_cast<char *>(p);
+				}
+			}
+
+			void flush(const std::string &path) {
+				if (size_ && ::msync(data_, size_, MS_SYNC) != 0)
+					throw std::system_error(errno, std::generic_category(), std::format("cannot flush {}", path));
+			}
+
+			char *data() const { return data_; }
+			size_t size() const { return size_; }
+
+		private:
+			int fd_ = -1;
+			char *data_ = nullptr;
+			size_t size_ = 0;
+		};
+#else
+		// no mmap: the input is read whole, the output is kept in memory until flush() writes it
+		class MappedFile
+		{
+		public:
+			MappedFile() = default;
+			MappedFile(const MappedFile &) = delete;
+			MappedFile &operator=(const MappedFile &) = delete;
+
+			static void openRead(MappedFile &f, const std::string &path) {
+				std::ifstream file(path, std::ios::binary);
+				if (!file)
+					throw std::system_error(errno, std::generic_category(), std::format("cannot open {}", path));
+				f.buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			}
+
+			static void createShared(MappedFile &f, const std::string &path, size_t size) {
+				f.buffer_.assign(size, '\0');
+				f.flush(path);      // create (and truncate) it up front, as the mmap version does
+			}
+
+			void flush(const std::string &path) {
+				std::ofstream file(path, std::ios::binary | std::ios::trunc);
+				if (!file.write(buffer_.data(), std::streamsize(buffer_.size())))
+					throw std::system_error(errno, std::generic_category(), std::format("cannot write {}", path));
+			}
+
+			char *data() { return buffer_.data(); }
+			size_t size() const { return buffer_.size(); }
+
+		private:
+			std::vector<char> buffer_;
+		};
+#endif
+
+		inline size_t countLines(const char *begin, const char *end) {
+			size_t n = 0;
+			while (begin < end) {
+				const char *nl = static_cast<const char *>(std::memchr(begin, '\n', size_t(end - begin)));
+				n++;
+				if (!nl)
+					break;
+				begin = nl + 1;
+			}
+			return n;
+		}
+
+		/// <summary>
+		/// Cut [data, data + size) into at most `count` shards at line boundaries and assign each shard its
+		/// first output record index.
+		/// </summary>
+		inline std::vector<Shard> planShards(const char *data, size_t size, unsigned count) {
+			std::vector<Shard> shards;
+			if (count == 0)
+				count = 1;
+			size_t pos = 0;
+			size_t record = 0;
+			for (unsigned i = 0; i < count && pos < size; i++) {
+				size_t end = (i + 1 == count ? size : std::max(pos, size / count * (i + 1)));
+				if (end < size) {
+					const char *nl = static_cast<const char *>(std::memchr(data + end, '\n', size - end));
+					end = nl ? size_t(nl - data) + 1 : size;
+				}
+				if (end <= pos)
+					continue;
+				Shard s{ pos, end, record, countLines(data + pos, data + end) };
+				record += s.records;
+				shards.push_back(s);
+				pos = end;
+			}
+			return shards;
+		}
+
+		template<typename int_type>
+		void writeRecord(char *out, bool binary, bool ok, const Fraction<int_type> &frac) {
+			if (binary) {
+				int64_t rec[2] = { ok ? int64_t(frac.numerator()) : 0, ok ? int64_t(frac.denominator()) : 0 };
+				std::memcpy(out, rec, sizeof(rec));
+				return;
+			}
+			char *p = out;
+			char *last = out + TextRecordWidth - 1;
+			if (ok) {
+				p = std::to_chars(p, last, frac.numerator()).ptr;
+				*p++ = '/';
+				p = std::to_chars(p, last, frac.denominator()).ptr;
+			}
+			else {
+				std::memcpy(p, "error", 5);
+				p += 5;
+			}
+			std::memset(p, ' ', size_t(last - p));
+			*last = '\n';
+		}
+
+		/// <summary>
+		/// Convert the lines of one shard into records at `out` (the shard's first record). Returns the number of
+		/// lines that could not be parsed or converted.
+		/// </summary>
+		template<typename int_type>
+		size_t convertShard(const char *data, const Shard &shard, char *out, const Options &opts) {
+			const size_t width = opts.binary ? BinaryRecordWidth : TextRecordWidth;
+			const char *p = data + shard.begin;
+			const char *end = data + shard.end;
+			size_t errors = 0;
+
+			for (size_t i = 0; i < shard.records; i++) {
+				const char *nl = static_cast<const char *>(std::memchr(p, '\n', size_t(end - p)));
+				const char *eol = nl ? nl : end;
+
+				// a line may carry extra TAB separated columns (see dataset_generator); only the first is used
+				const char *tok = p;
+				while (tok < eol && (*tok == ' ' || *tok == '\t'))
+					tok++;
+				if (tok < eol && *tok == '+')
+					tok++;
+
+				double val = 0;
+				auto [ptr, ec] = std::from_chars(tok, eol, val);
+				bool ok = (ec == std::errc() && ptr != tok);
+				Fraction<int_type> frac;
+				if (ok) {
+					try {
+						frac = toFract<int_type>(val, opts.precision);
+					}
+					catch (const std::exception &) {
+						ok = false;
+					}
+				}
+				if (!ok)
+					errors++;
+				writeRecord<int_type>(out + i * width, opts.binary, ok, frac);
+
+				p = nl ? nl + 1 : end;
+			}
+			return errors;
+		}
+
+		// a failed shard may have stopped midway: rewrite all of its records as errors, so that the output
+		// holds either a shard's complete conversion or error records (and stays a text file in text mode)
+		inline void markFailed(const std::vector<size_t> &which, const std::vector<Shard> &shards, char *out, bool binary) {
+			const size_t width = binary ? BinaryRecordWidth : TextRecordWidth;
+			for (size_t i : which) {
+				for (size_t r = 0; r < shards[i].records; r++)
+					writeRecord<int64_t>(out + (shards[i].firstRecord + r) * width, binary, false, {});
+			}
+		}
+
+		template<typename int_type>
+		Result convertFile(const std::string &inPath, const std::string &outPath, Options opts) {
+			if (opts.workers == 0)
+				opts.workers = std::max(1u, std::thread::hardware_concurrency());
+
+			MappedFile in;
+			MappedFile::openRead(in, inPath);
+			std::vector<Shard> shards = planShards(in.data(), in.size(), opts.workers);
+
+			Result rv;
+			rv.records = shards.empty() ? 0 : shards.back().firstRecord + shards.back().records;
+
+			const size_t width = opts.binary ? BinaryRecordWidth : TextRecordWidth;
+			MappedFile out;
+			MappedFile::createShared(out, outPath, rv.records * width);
+			if (rv.records == 0)
+				return rv;
+
+			if (opts.mode == WorkerMode::Threads || !CVT2FRAC_SHARDED_POSIX) {
+				std::vector<std::thread> threads;
+				std::vector<char> failed(shards.size(), 0);
+				for (size_t i = 0; i < shards.size(); i++) {
+					threads.emplace_back([&, i] {
+						detail::debugMuted() = true;
+						try {
+							convertShard<int_type>(in.data(), shards[i], out.data() + shards[i].firstRecord * width, opts);
+						}
+						catch (...) {
+							failed[i] = 1;
+						}
+					});
+				}
+				for (std::thread &t : threads)
+					t.join();
+				for (size_t i = 0; i < shards.size(); i++) {
+					if (failed[i])
+						rv.failedShards.push_back(i);
+				}
+				markFailed(rv.failedShards, shards, out.data(), opts.binary);
+				out.flush(outPath);
+				return rv;
+			}
+
+#if CVT2FRAC_SHARDED_POSIX
+			// process mode: the output mapping is MAP_SHARED, so writes by the children land in the file directly.
+			std::vector<size_t> pending(shards.size());
+			for (size_t i = 0; i < shards.size(); i++)
+				pending[i] = i;
+
+			for (unsigned attempt = 0; attempt <= opts.retries && !pending.empty(); attempt++) {
+				std::vector<pid_t> pids(pending.size(), -1);
+				for (size_t k = 0; k < pending.size(); k++) {
+					pid_t pid = ::fork();
+					if (pid == 0) {
+						detail::debugMuted() = true;
+						int status = 0;
+						try {
+							const Shard &s = shards[pending[k]];
+							convertShard<int_type>(in.data(), s, out.data() + s.firstRecord * width, opts);
+						}
+						catch (...) {
+							status = 1;
+						}
+						::_exit(status);
+					}
+					pids[k] = pid;    // -1 on fork failure: counted as a failed shard below
+				}
+
+				std::vector<size_t> failed;
+				for (size_t k = 0; k < pending.size(); k++) {
+					int status = 0;
+					if (pids[k] < 0 || ::waitpid(pids[k], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+						if (DebugReporting) {
+							std::cerr << std::format("sharded: shard {} failed (attempt {}, status {:#x})\n", pending[k], attempt, status);
+						}
+						failed.push_back(pending[k]);
+					}
+				}
+				pending.swap(failed);
+			}
+
+			rv.failedShards = pending;
+			markFailed(rv.failedShards, shards, out.data(), opts.binary);
+			out.flush(outPath);
+#endif
+			return rv;
+		}
+	}
+}
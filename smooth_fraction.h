@@ -0,0 +1,167 @@
+
+#pragma once
+
+#include "./convert_to_fraction.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace cvt_2_fraction
+{
+	enum class SmoothPart
+	{
+		Denominator,    // only the denominator must factor over the primes
+		Both,           // numerator and denominator
+	};
+
+	/// <summary>
+	/// <para>Ascending enumeration of the smooth numbers over a set of primes: 1, then every product of
+	/// the primes, e.g. 1, 2, 3, 4, 5, 6, 8, 9, 10, 12, 15, 16, ... for { 2, 3, 5 }.</para>
+	///
+	/// <para>
+	/// A min-heap holds the frontier; a number is only ever extended by primes not smaller than its own
+	/// largest prime factor, so every value is generated exactly once and the heap stays small.</para>
+	/// </summary>
+	template<typename int_type>
+	class SmoothNumbers
+	{
+	public:
+		SmoothNumbers(std::span<const int_type> primes, int_type limit)
+			: primes(primes.begin(), primes.end()), limit(limit)
+			{
+				if (this->primes.empty())
+					throw std::invalid_argument("SmoothNumbers: no primes given");
+				std::sort(this->primes.begin(), this->primes.end());
+				this->primes.erase(std::unique(this->primes.begin(), this->primes.end()), this->primes.end());
+				if (this->primes.front() < 2)
+					throw std::invalid_argument(std::format("SmoothNumbers: {} is not a prime", this->primes.front()));
+				if (limit >= 1)
+					heap.push({ int_type(1), 0 });
+			}
+
+		/// <summary>
+		/// The next smooth number &lt;= limit; false when there is none.
+		/// </summary>
+		bool next(int_type &value) {
+				if (heap.empty())
+					return false;
+				auto [v, first] = heap.top();
+				heap.pop();
+				for (size_t i = first; i < primes.size(); i++) {
+					int_type w;
+					if (checkedMul(v, primes[i], w) || w > limit)
+						break;      // primes are ascending: the larger ones overshoot as well
+					heap.push({ w, i });
+				}
+				value = v;
+				return true;
+			}
+
+	private:
+		// (value, index of its largest prime factor)
+		using Entry = std::pair<int_type, size_t>;
+
+		std::vector<int_type> primes;
+		int_type limit;
+		std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+	};
+
+	/// <summary>
+	/// <para>The fraction p/q with |val - p/q| &lt; Precision whose denominator q has no prime factors
+	/// outside `primes` (with SmoothPart::Both, neither has p), choosing the smallest such q and, for it,
+	/// the p closest to val. Returns nothing when no such q &lt;= maxDenominator exists.</para>
+	///
+	/// <para>
+	/// Unlike toFract(), Precision bounds the absolute error of the result. Candidate denominators come
+	/// in ascending order from SmoothNumbers, and every one is settled with a single multiplication: the
+	/// admissible numerators are the integers in (q (val - Precision), q (val + Precision)). That window,
+	/// in doubles, only proposes the numerator; it and its neighbours are accepted by the residual test of
+	/// toFract(), which stays exact where q val is past 2^53. Filtering unconstrained approximations
+	/// instead almost never produces a smooth denominator.</para>
+	/// </summary>
+	template<typename int_type>
+	std::optional<Fraction<int_type>> toSmoothFract(double val, double Precision, std::span<const int_type> primes,
+			SmoothPart part = SmoothPart::Denominator, int_type maxDenominator = std::numeric_limits<int_type>::max())
+		{
+			constexpr int_type MaxValue{std::numeric_limits<int_type>::max()};
+
+			if (!std::isfinite(val))
+				throw std::invalid_argument(std::format("toSmoothFract: cannot approximate {}", val));
+			if (!(Precision > 0))
+				throw std::invalid_argument(std::format("toSmoothFract: precision must be positive, not {}", Precision));
+
+			const double mag = std::abs(val);
+			if (mag < Precision)
+				return Fraction<int_type>(0);
+
+			// SmoothPart::Both: the smooth numerators, generated as far as the numerator windows have reached
+			SmoothNumbers<int_type> numeratorSource(primes, MaxValue);
+			std::vector<int_type> numerators;
+
+			SmoothNumbers<int_type> denominators(primes, maxDenominator);
+			int_type q;
+			while (denominators.next(q)) {
+				// the admissible numerators are the integers in (lo, hi); doubles only propose them
+				const double lo = double(q) * (mag - Precision);
+				const double hi = double(q) * (mag + Precision);
+				if (lo >= 2 * double(MaxValue))
+					break;      // every larger q needs a still larger numerator (with room for the rounding of lo)
+
+				// the candidate closest to q * mag among those that pass the residual test, which is exact
+				// past 2^53 where the window above has lost the integers
+				std::optional<int_type> best;
+				double bestError = 0;
+				auto consider = [&](int_type p) {
+					const double error = std::abs(detail::residual(p, q, mag));
+					if (error < Precision * double(q) && (!best || error < bestError)) {
+						best = p;
+						bestError = error;
+					}
+				};
+
+				const double target = double(q) * mag;
+				if (part == SmoothPart::Both) {
+					int_type v;
+					while ((numerators.empty() || double(numerators.back()) <= hi) && numeratorSource.next(v))
+						numerators.push_back(v);
+					auto it = std::lower_bound(numerators.begin(), numerators.end(), target, [](int_type a, double b) { return double(a) < b; });
+					// smooth numbers are sparse: the neighbours of the (rounded) target bracket q * mag
+					const auto first = (it != numerators.begin() ? it - 1 : it);
+					const auto last = (it == numerators.end() ? it : std::min(it + 2, numerators.end()));
+					for (auto c = first; c != last; c++)
+						consider(*c);
+				}
+				else {
+					int_type p = (target >= double(MaxValue) ? MaxValue : int_type(std::round(target)));
+					// past 2^53 the rounded target is off by up to half an ulp: move by the residual, which
+					// is formed from the integers and lands within one of q * mag
+					const double shift = std::round(detail::residual(p, q, mag));
+					if (shift > 0)
+						p = (shift >= double(MaxValue - p) ? MaxValue : p + int_type(shift));
+					else if (shift < 0)
+						p = (-shift >= double(p) ? 0 : p - int_type(-shift));
+					consider(p);
+					if (p > 0)
+						consider(p - 1);
+					if (p < MaxValue)
+						consider(p + 1);
+				}
+				if (!best)
+					continue;
+
+				Fraction<int_type> rv(val < 0 ? int_type(-*best) : *best, q);
+				if (DebugReporting) {
+					detail::debugReport("SmoothFraction: val = {}, precision = {}: answer = {}\n", val, Precision, rv);
+				}
+				return rv;
+			}
+			return std::nullopt;
+		}
+}
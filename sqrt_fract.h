@@ -0,0 +1,208 @@
+
+#pragma once
+
+#include "./convert_to_fraction.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cvt_2_fraction
+{
+	namespace detail
+	{
+		// wide enough for p * q of two int_type values; 64-bit types need the builtin 128-bit integer
+#if defined(__SIZEOF_INT128__)
+		constexpr bool SqrtHasInt128 = true;
+		template<typename int_type>
+		using SqrtWide = std::conditional_t<(sizeof(int_type) <= sizeof(int32_t)), int64_t, __int128>;
+#else
+		constexpr bool SqrtHasInt128 = false;
+		template<typename int_type>
+		using SqrtWide = int64_t;
+#endif
+
+		// floor(sqrt(n)), n >= 0: Newton steps from the double estimate, then exact
+		template<typename wide_type>
+		wide_type isqrt(wide_type n) {
+				if (n < 2)
+					return n;
+				wide_type x = wide_type(std::sqrt(double(n)));
+				for (int i = 0; i < 4 && x > 0; i++)
+					x = (x + n / x) / 2;
+				while (x > 0 && x > n / x)
+					x--;
+				while ((x + 1) <= n / (x + 1))
+					x++;
+				return x;
+			}
+	}
+
+	/// <summary>
+	/// <para>The continued fraction of sqrt(r), r = p/q &gt;= 0, with integer arithmetic only: sqrt(p/q) =
+	/// sqrt(D) / q with D = p q, a quadratic irrational (P + sqrt(D)) / Q whose states follow</para>
+	/// <code>
+	///     a_i = floor((P_i + floor(sqrt(D))) / Q_i),   P_(i+1) = a_i Q_i - P_i,   Q_(i+1) = (D - P_(i+1)^2) / Q_i
+	/// </code>
+	/// <para>
+	/// from P_0 = 0, Q_0 = q (Q_0 divides D - P_0^2). The expansion is eventually periodic: terms are
+	/// produced on demand, and once a state repeats the period is known and later terms are read from it.
+	/// (A period can be as long as sqrt(D), so it is never computed ahead.) For a perfect square p q the
+	/// expansion is that of the rational sqrt(D) / q, and ends.</para>
+	/// </summary>
+	template<typename int_type>
+	class SqrtExpansion
+	{
+		static_assert(std::is_integral_v<int_type> && sizeof(int_type) <= sizeof(int64_t), "SqrtExpansion needs a builtin integer type");
+		static_assert(sizeof(int_type) <= sizeof(int32_t) || detail::SqrtHasInt128, "SqrtExpansion of a 64-bit int_type needs __int128, which this compiler lacks");
+	public:
+		using wide_type = detail::SqrtWide<int_type>;
+
+		explicit SqrtExpansion(const Fraction<int_type> &r)
+			{
+				if (r < 0)
+					throw std::invalid_argument(std::format("SqrtExpansion: the square root of {} is not real", r));
+				D = wide_type(r.numerator()) * wide_type(r.denominator());
+				root = detail::isqrt(D);
+				if (root * root == D) {
+					// rational: the terms of root / q, all of them
+					for (wide_type n = root, d = r.denominator(); d != 0;) {
+						terms.push_back(n / d);
+						wide_type rem = n % d;
+						n = d;
+						d = rem;
+					}
+					finite = true;
+					return;
+				}
+				states.push_back({ 0, r.denominator() });
+			}
+
+		/// <summary>
+		/// Term a_i into `a`; false past the end of a finite (rational) expansion.
+		/// </summary>
+		bool term(size_t i, wide_type &a) {
+				if (periodLength != 0 && i >= terms.size())
+					i = periodStart + (i - periodStart) % periodLength;
+				while (!finite && periodLength == 0 && i >= terms.size())
+					extend();
+				if (i >= terms.size())
+					return false;
+				a = terms[i];
+				return true;
+			}
+
+		/// <summary>
+		/// The length of the period, 0 while it is not known (or the expansion is finite), and the index of
+		/// its first term.
+		/// </summary>
+		size_t period() const { return periodLength; }
+		size_t preperiod() const { return periodStart; }
+
+		/// <summary>
+		/// <para>The best approximation of sqrt(r) with denominator &lt;= bound whose numerator fits in int_type:
+		/// the last convergent that fits, or the best semiconvergent (h_(n-2) + j h_(n-1)) / (k_(n-2) + j k_(n-1))
+		/// past it. A semiconvergent with 2 j &gt; a_n is closer, one with 2 j &lt; a_n is not; for 2 j == a_n
+		/// the half rule decides: it is closer iff [a_n; a_(n-1), ..., a_1] &gt; [a_n; a_(n+1), ...].</para>
+		/// </summary>
+		Fraction<int_type> approximate(int_type bound) {
+				constexpr int_type MaxValue{std::numeric_limits<int_type>::max()};
+				if (bound < 1)
+					throw std::invalid_argument(std::format("SqrtExpansion: invalid denominator bound {}", bound));
+
+				int_type h2 = 0, k2 = 1, h1 = 1, k1 = 0;
+				for (size_t n = 0;; n++) {
+					wide_type a;
+					if (!term(n, a))
+						return Fraction<int_type>(h1, k1);     // exact, and within bounds
+
+					// the largest j <= a_n with k_(n-2) + j k_(n-1) <= bound and h_(n-2) + j h_(n-1) <= MaxValue
+					wide_type j = a;
+					if (k1 > 0)
+						j = std::min(j, wide_type((bound - k2) / k1));
+					if (h1 > 0)
+						j = std::min(j, wide_type((MaxValue - h2) / h1));
+					if (j == a) {
+						int_type h = int_type(h2 + int_type(a) * h1), k = int_type(k2 + int_type(a) * k1);
+						h2 = h1; k2 = k1;
+						h1 = h; k1 = k;
+						continue;
+					}
+					// (n >= 1: a_0 <= sqrt(MaxValue) always fits)
+					if (2 * j > a || (2 * j == a && halfRule(n)))
+						return Fraction<int_type>(int_type(h2 + int_type(j) * h1), int_type(k2 + int_type(j) * k1));
+					return Fraction<int_type>(h1, k1);
+				}
+			}
+
+	private:
+		void extend() {
+				auto [P, Q] = states.back();
+				wide_type a = (P + root) / Q;
+				terms.push_back(a);
+				wide_type next = a * Q - P;
+				states.push_back({ next, (D - next * next) / Q });
+				// a state seen before closes the period
+				for (size_t i = 0; i + 1 < states.size(); i++) {
+					if (states[i] == states.back()) {
+						periodStart = i;
+						periodLength = states.size() - 1 - i;
+						break;
+					}
+				}
+			}
+
+		// [a_n; a_(n-1), ..., a_1] > [a_n; a_(n+1), ...]
+		bool halfRule(size_t n) {
+				for (size_t i = 1;; i++) {
+					wide_type x, y;
+					const bool xEnds = !term(n + i, x);
+					const bool yEnds = (i >= n);
+					if (xEnds && yEnds)
+						return false;       // equally close: keep the smaller denominator
+					if (yEnds)
+						return (i - 1) % 2 != 0;
+					term(n - i, y);
+					if (xEnds)
+						return (i - 1) % 2 == 0;
+					if (x != y)
+						return (y > x) == (i % 2 == 0);
+				}
+			}
+
+		wide_type D = 0, root = 0;
+		std::vector<wide_type> terms;
+		std::vector<std::pair<wide_type, wide_type>> states;    // (P_i, Q_i)
+		bool finite = false;
+		size_t periodStart = 0, periodLength = 0;
+	};
+
+	/// <summary>
+	/// <para>The best approximation of sqrt(r) with denominator &lt;= bound (see SqrtExpansion::approximate()),
+	/// computed exactly: unlike toFract(std::sqrt(...)), it is not limited by the double square root.</para>
+	///
+	/// <para>
+	/// The expansion of every r is cached per thread, so further bounds for the same r reuse the terms (and
+	/// the period) already found; the cache is dropped once it holds CacheSize values.</para>
+	/// </summary>
+	template<typename int_type>
+	Fraction<int_type> sqrtFract(const Fraction<int_type> &r, int_type bound)
+		{
+			constexpr size_t CacheSize = 256;
+			thread_local std::map<std::pair<int_type, int_type>, SqrtExpansion<int_type>> cache;
+
+			const std::pair<int_type, int_type> key(r.numerator(), r.denominator());
+			auto it = cache.find(key);
+			if (it == cache.end()) {
+				if (cache.size() >= CacheSize)
+					cache.clear();
+				it = cache.emplace(key, SqrtExpansion<int_type>(r)).first;
+			}
+			return it->second.approximate(bound);
+		}
+}
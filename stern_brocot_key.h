@@ -0,0 +1,269 @@
+
+#pragma once
+
+#include "./convert_to_fraction.h"
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace cvt_2_fraction
+{
+	namespace detail
+	{
+		constexpr uint8_t SBKeyNegative = 0x01, SBKeyZero = 0x02, SBKeyPositive = 0x03, SBKeyInfinity = 0x04;
+		constexpr uint8_t SBKeyBelowOne = 0x40, SBKeyOne = 0x80, SBKeyAboveOne = 0xC0;
+		constexpr uint8_t SBKeyEndAfterR = 0xFF, SBKeyEndAfterL = 0x00;
+		constexpr uint8_t SBKeyShortRun = 0xF7;
+
+		// `mask` complements the bytes: L runs, and everything in the key of a negative value
+		inline void appendRun(std::string &out, uint64_t run, uint8_t mask) {
+				if (run <= SBKeyShortRun) {
+					out.push_back(char(uint8_t(run) ^ mask));
+					return;
+				}
+				unsigned n = 0;
+				for (uint64_t v = run; v != 0; v >>= 8)
+					n++;
+				out.push_back(char(uint8_t(SBKeyShortRun + n) ^ mask));
+				for (unsigned i = n; i-- > 0;)
+					out.push_back(char(uint8_t(run >> (8 * i)) ^ mask));
+			}
+
+		// false for a truncated run or one not in its shortest form
+		inline bool readRun(std::string_view key, size_t &pos, uint8_t mask, uint64_t &run) {
+				uint8_t b = uint8_t(key[pos++]) ^ mask;
+				if (b <= SBKeyShortRun) {
+					run = b;
+					return b != 0;
+				}
+				unsigned n = b - SBKeyShortRun;
+				if (key.size() - pos < n)
+					return false;
+				run = 0;
+				for (unsigned i = 0; i < n; i++)
+					run = (run << 8) | (uint8_t(key[pos++]) ^ mask);
+				return run > SBKeyShortRun && (run >> (8 * (n - 1))) != 0;
+			}
+
+		// the key of p/q > 0 (coprime) without the sign byte
+		inline void appendMagnitudeKey(std::string &out, uint64_t p, uint64_t q, uint8_t mask) {
+				if (p == q) {
+					out.push_back(char(SBKeyOne ^ mask));
+					return;
+				}
+				const bool below = (p < q);
+				out.push_back(char((below ? SBKeyBelowOne : SBKeyAboveOne) ^ mask));
+				if (below)
+					std::swap(p, q);    // x = [0; a1, a2, ...]: the terms of 1/x, starting with an L run
+				bool right = !below;
+				for (;;) {
+					uint64_t a = p / q, r = p % q;
+					if (r == 0) {
+						// the last run is a_n - 1 (a_n >= 2 here, Euclid ends on a canonical expansion)
+						appendRun(out, a - 1, right ? mask : uint8_t(~mask));
+						out.push_back(char((right ? SBKeyEndAfterR : SBKeyEndAfterL) ^ mask));
+						return;
+					}
+					appendRun(out, a, right ? mask : uint8_t(~mask));
+					right = !right;
+					p = q;
+					q = r;
+				}
+			}
+
+		inline void invalidKey(const char *why) {
+				throw std::invalid_argument(std::format("fromSternBrocotKey: {}", why));
+			}
+
+		inline void readMagnitudeKey(std::string_view key, size_t &pos, uint8_t mask, uint64_t &p, uint64_t &q) {
+				if (pos >= key.size())
+					invalidKey("truncated key");
+				const uint8_t lead = uint8_t(key[pos++]) ^ mask;
+				if (lead == SBKeyOne) {
+					p = q = 1;
+					return;
+				}
+				if (lead != SBKeyBelowOne && lead != SBKeyAboveOne)
+					invalidKey("invalid lead byte");
+
+				// convergents of the terms: the runs, the last one plus 1
+				uint64_t h2 = 0, k2 = 1, h1 = 1, k1 = 0;
+				auto push = [&](uint64_t a) {
+					uint64_t h, k;
+					if (checkedMul(a, h1, h) || checkedAdd(h, h2, h) || checkedMul(a, k1, k) || checkedAdd(k, k2, k))
+						throw std::overflow_error("fromSternBrocotKey: the value does not fit in 64 bits");
+					h2 = h1; k2 = k1;
+					h1 = h; k1 = k;
+				};
+				bool right = (lead == SBKeyAboveOne);
+				uint64_t last = 0;
+				for (bool any = false;; any = true) {
+					if (pos >= key.size())
+						invalidKey("truncated key");
+					if (any && (uint8_t(key[pos]) ^ mask) == (right ? SBKeyEndAfterL : SBKeyEndAfterR)) {
+						pos++;
+						break;
+					}
+					uint64_t run;
+					if (!readRun(key, pos, right ? mask : uint8_t(~mask), run))
+						invalidKey("invalid run");
+					if (any)
+						push(last);
+					last = run;
+					right = !right;
+				}
+				if (last == std::numeric_limits<uint64_t>::max())
+					throw std::overflow_error("fromSternBrocotKey: the value does not fit in 64 bits");
+				push(last + 1);
+				p = h1;
+				q = k1;
+				if (lead == SBKeyBelowOne)
+					std::swap(p, q);
+			}
+
+		// the magnitude |v| of a builtin integer, also for the most negative value
+		template<typename int_type>
+		uint64_t magnitude(int_type v) {
+				return v < 0 ? uint64_t(0) - uint64_t(v) : uint64_t(v);
+			}
+	}
+
+	/// <summary>
+	/// <para>Order-preserving binary keys for fractions: memcmp() order of the keys is the numeric order of
+	/// the values, so fractions can be stored as B-tree / LSM keys or radix sorted without decoding or
+	/// cross multiplication.</para>
+	///
+	/// <para>
+	/// The key of x &gt; 0 is its Stern-Brocot path as run lengths, R^a0 L^a1 R^a2 ... with the last run
+	/// a_n - 1: the continued fraction terms toFract() walks through. A node lies between its left (L,
+	/// smaller) and right (R, larger) subtrees, so paths compare like strings over L &lt; end &lt; R. Runs
+	/// are written as order-preserving variable length integers, R runs as they are and L runs complemented
+	/// (a longer L run is a smaller value). A path ends in 0xFF after an R run and in 0x00 after an L run,
+	/// bytes the next run can never start with. Layout:</para>
+	/// <code>
+	///     x &lt; 0     0x01, then the magnitude key of |x|, complemented
+	///     x == 0    0x02
+	///     x &gt; 0     0x03, then the magnitude key: 0x40 (x &lt; 1, the path starts with L), 0x80 (x == 1,
+	///               the empty path) or 0xC0 (x &gt; 1), the runs and the end byte (none for x == 1)
+	///     run r     r &lt;= 0xF7: the byte r; otherwise 0xF7 + n, then r in n big-endian bytes
+	/// </code>
+	///
+	/// <para>
+	/// Keys are prefix-free, and at most 3 + 9 * 93 bytes long for 64-bit terms. The Stern-Brocot
+	/// subtree below x holds exactly the values between x's two parents, so it is the key range between
+	/// theirs: see sternBrocotSubtree().</para>
+	/// </summary>
+	template<typename int_type>
+	void appendSternBrocotKey(std::string &out, const Fraction<int_type> &frac)
+		{
+			static_assert(std::is_integral_v<int_type> && sizeof(int_type) <= sizeof(uint64_t), "Stern-Brocot keys need a builtin integer type");
+
+			if (frac.numerator() == 0) {
+				out.push_back(char(detail::SBKeyZero));
+				return;
+			}
+			const bool negative = (frac.numerator() < 0);
+			out.push_back(char(negative ? detail::SBKeyNegative : detail::SBKeyPositive));
+			detail::appendMagnitudeKey(out, detail::magnitude(frac.numerator()), uint64_t(frac.denominator()), negative ? 0xFF : 0x00);
+		}
+
+	template<typename int_type>
+	std::string sternBrocotKey(const Fraction<int_type> &frac)
+		{
+			std::string rv;
+			appendSternBrocotKey(rv, frac);
+			return rv;
+		}
+
+	/// <summary>
+	/// The fraction a key holds, reading one key from the front of `key` (the number of bytes used is
+	/// stored in `used`). Malformed keys throw std::invalid_argument, values that do not fit in int_type
+	/// std::overflow_error.
+	/// </summary>
+	template<typename int_type>
+	Fraction<int_type> fromSternBrocotKey(std::string_view key, size_t *used = nullptr)
+		{
+			static_assert(std::is_integral_v<int_type> && sizeof(int_type) <= sizeof(uint64_t), "Stern-Brocot keys need a builtin integer type");
+			constexpr uint64_t MaxValue = uint64_t(std::numeric_limits<int_type>::max());
+
+			if (key.empty())
+				detail::invalidKey("empty key");
+			size_t pos = 1;
+			Fraction<int_type> rv;
+			switch (uint8_t(key[0])) {
+			case detail::SBKeyZero:
+				break;
+			case detail::SBKeyPositive:
+			case detail::SBKeyNegative: {
+				const bool negative = (uint8_t(key[0]) == detail::SBKeyNegative);
+				uint64_t p, q;
+				detail::readMagnitudeKey(key, pos, negative ? 0xFF : 0x00, p, q);
+				// (a negative numerator may reach -(MaxValue + 1))
+				if (p > MaxValue + (negative && std::is_signed_v<int_type> ? 1 : 0) || q > MaxValue)
+					throw std::overflow_error(std::format("fromSternBrocotKey: {}/{} does not fit in int_type", p, q));
+				rv.assign(int_type(negative ? uint64_t(0) - p : p), int_type(q));
+				break;
+			}
+			default:
+				detail::invalidKey("invalid sign byte");
+			}
+			if (used)
+				*used = pos;
+			return rv;
+		}
+
+	/// <summary>
+	/// The exclusive key bounds (low, high) of the Stern-Brocot subtree below frac != 0: every key
+	/// strictly between them, and no other, is that of a descendant of frac (or frac itself). The values
+	/// are those between frac's two parents; an unbounded side (1/0) gets a key beyond every value's.
+	/// </summary>
+	template<typename int_type>
+	std::pair<std::string, std::string> sternBrocotSubtree(const Fraction<int_type> &frac)
+		{
+			if (frac.numerator() == 0)
+				throw std::invalid_argument("sternBrocotSubtree: 0 is not in the Stern-Brocot tree");
+
+			// the parents of p/q = [a0; ..., an] are the previous convergent h/k and (p - h)/(q - k)
+			const uint64_t p = detail::magnitude(frac.numerator()), q = uint64_t(frac.denominator());
+			uint64_t h2 = 0, k2 = 1, h1 = 1, k1 = 0;
+			for (uint64_t n = p, d = q; d != 0;) {
+				uint64_t a = n / d, r = n % d;
+				if (r == 0)
+					break;      // the last term: h1/k1 is the previous convergent
+				uint64_t h = a * h1 + h2, k = a * k1 + k2;
+				h2 = h1; k2 = k1;
+				h1 = h; k1 = k;
+				n = d;
+				d = r;
+			}
+			std::pair<uint64_t, uint64_t> parents[2] = { { h1, k1 }, { p - h1, q - k1 } };
+			// ordered by value: a/b < c/d; 1/0 is the largest
+			uint64_t hi0, hi1;
+			const uint64_t lo0 = detail::mulWide(parents[0].first, parents[1].second, hi0);
+			const uint64_t lo1 = detail::mulWide(parents[1].first, parents[0].second, hi1);
+			if (hi0 > hi1 || (hi0 == hi1 && lo0 > lo1))
+				std::swap(parents[0], parents[1]);
+
+			auto keyOf = [](std::pair<uint64_t, uint64_t> v, bool negative) {
+				std::string rv;
+				if (v.second == 0)
+					rv.push_back(char(negative ? detail::SBKeyNegative - 1 : detail::SBKeyInfinity));
+				else if (v.first == 0)
+					rv.push_back(char(detail::SBKeyZero));
+				else {
+					// (the parents are in lowest terms: their determinant with frac is 1)
+					rv.push_back(char(negative ? detail::SBKeyNegative : detail::SBKeyPositive));
+					detail::appendMagnitudeKey(rv, v.first, v.second, negative ? 0xFF : 0x00);
+				}
+				return rv;
+			};
+			if (frac.numerator() < 0)
+				return { keyOf(parents[1], true), keyOf(parents[0], true) };
+			return { keyOf(parents[0], false), keyOf(parents[1], false) };
+		}
+}
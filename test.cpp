@@ -1,5 +1,29 @@
 
 #include "./convert_to_fraction.h"
+#include "./dataset_generator.h"
+#include "./sharded_convert.h"
+#include "./fraction_parse.h"
+#include "./mulshift.h"
+#include "./prepared_fraction.h"
+#include "./rational_stepper.h"
+#include "./cf_arithmetic.h"
+#include "./fraction_pool.h"
+#include "./fraction_index.h"
+#include "./smooth_fraction.h"
+#include "./arrow_batch.h"
+#include "./ratio_tracker.h"
+#include "./cf_matrix.h"
+#include "./sar_planner.h"
+#include "./stern_brocot_key.h"
+#include "./constant_recognizer.h"
+#include "./integer_relation.h"
+#include "./sqrt_fract.h"
+
+#include <boost/multiprecision/cpp_int.hpp>
+
+#include <atomic>
+#include <sstream>
+#include <thread>
 
 #include <cstdint>
 
@@ -57,11 +81,972 @@ namespace
 
 
 
+	void TestOverflowGuard(void)
+	{
+		// pi = [3; 7, 15, 1, 292, ...]: past 355/113 only semiconvergents (333 + k 355) / (106 + k 113) with
+		// k <= 91 fit in int16_t, all of them worse than 355/113
+		assert(toFract<int16_t>(std::numbers::pi_v<double>, 1E-12) == Fraction<int16_t>(355, 113));
+
+		// a precision no double can meet runs the descent to the exact double or the end of the range
+		Fraction<int32_t> r = toFract<int32_t>(1.0 / std::sqrt(2.0), 1E-30);
+		assert(r.denominator() > (1 << 26) && std::abs(toFloat(r) - 1.0 / std::sqrt(2.0)) < 1E-16);
+
+		// the integer part counts against the numerator as well
+		assert(toFract<int32_t>(2000000000.25, 1E-12) == Fraction<int32_t>(2000000000));
+		assert(toFract<int32_t>(2000000000.75, 1E-12) == Fraction<int32_t>(2000000001));
+		bool thrown = false;
+		try {
+			toFract<int32_t>(3E9);
+		}
+		catch (const std::invalid_argument &) {
+			thrown = true;
+		}
+		assert(thrown);
+	}
+
+
+
+	void TestDatasetGenerator(void)
+	{
+		dataset::Options opts;
+		opts.kind = dataset::Distribution::ExactRatio;
+		opts.count = 200;
+		opts.seed = 42;
+
+		std::vector<dataset::Sample> a = dataset::generate(opts);
+		std::vector<dataset::Sample> b = dataset::generate(opts);
+		assert(a.size() == opts.count);
+		for (size_t i = 0; i < a.size(); i++) {
+			assert(a[i].value == b[i].value);
+			assert(a[i].denominator > 0 && a[i].denominator <= opts.maxDenominator);
+
+			// denominators <= 1000 are recovered exactly at this precision:
+			Fraction<int64_t> ret = toFract<int64_t>(a[i].value, 1E-9);
+			assert(ret.numerator() == a[i].numerator);
+			assert(ret.denominator() == a[i].denominator);
+		}
+
+		for (size_t k = 0; k < std::size(dataset::DistributionNames); k++) {
+			opts.kind = dataset::Distribution(k);
+			for (const dataset::Sample &s : dataset::generate(opts)) {
+				assert(std::isfinite(s.value));
+				if (opts.kind != dataset::Distribution::HeavyTailed) {
+					assert(s.value >= opts.lo - 1 && s.value <= opts.hi + 1);
+				}
+			}
+		}
+
+		// numerators beyond int64_t are rejected up front
+		opts.kind = dataset::Distribution::ShortDecimal;
+		opts.decimals = 18;
+		opts.hi = 100;
+		bool thrown = false;
+		try {
+			dataset::Generator gen(opts);
+		}
+		catch (const std::invalid_argument &) {
+			thrown = true;
+		}
+		assert(thrown);
+		opts.hi = 1;
+		for (const dataset::Sample &s : dataset::generate(opts))
+			assert(s.value >= 0 && s.value < 1);
+	}
+
+
+
+	void TestShardPlan(void)
+	{
+		std::string_view text = "0.5\n0.25\n0.125\n1.5\n2.75\n0.1\n0.2";
+		for (unsigned count = 1; count <= 9; count++) {
+			std::vector<sharded::Shard> shards = sharded::planShards(text.data(), text.size(), count);
+			size_t pos = 0, record = 0;
+			for (const sharded::Shard &s : shards) {
+				assert(s.begin == pos && s.firstRecord == record);
+				assert(s.begin == 0 || text[s.begin - 1] == '\n');
+				pos = s.end;
+				record += s.records;
+			}
+			assert(pos == text.size() && record == 7);
+		}
+
+		sharded::Options opts;
+		std::vector<sharded::Shard> shards = sharded::planShards(text.data(), text.size(), 3);
+		std::string out(7 * sharded::TextRecordWidth, '\0');
+		for (const sharded::Shard &s : shards)
+			sharded::convertShard<int>(text.data(), s, out.data() + s.firstRecord * sharded::TextRecordWidth, opts);
+		assert(out.substr(0, 4) == "1/2 ");
+		assert(out.substr(4 * sharded::TextRecordWidth, 5) == "11/4 ");
+		assert(out.back() == '\n');
+
+		// a failed shard becomes error lines, its neighbours are left alone
+		sharded::markFailed({ 1 }, shards, out.data(), false);
+		for (size_t r = 0; r < 7; r++) {
+			const std::string line = out.substr(r * sharded::TextRecordWidth, sharded::TextRecordWidth);
+			const bool failed = (r >= shards[1].firstRecord && r < shards[1].firstRecord + shards[1].records);
+			assert((line.substr(0, 6) == "error ") == failed && line.back() == '\n' && line.find('\0') == std::string::npos);
+		}
+		assert(out.substr(0, 4) == "1/2 ");
+	}
+
+
+
+	void TestFractionParse(void)
+	{
+		Fraction<int> f;
+		std::string_view text;
+
+		text = "16/9";
+		assert(fromChars(text, f).ec == std::errc() && f == Fraction<int>(16, 9));
+		text = "-32:18";
+		assert(fromChars(text, f).ec == std::errc() && f == Fraction<int>(-16, 9));
+		text = "-1 3/4 rest";
+		auto rv = fromChars(text, f);
+		assert(rv.ec == std::errc() && f == Fraction<int>(-7, 4) && std::string_view(rv.ptr) == " rest");
+		text = "42";
+		assert(fromChars(text, f).ec == std::errc() && f == Fraction<int>(42));
+		text = "1/0";
+		assert(fromChars(text, f).ec == std::errc::invalid_argument);
+		text = "1/-2";
+		assert(fromChars(text, f).ec == std::errc::invalid_argument);
+		text = "3000000000/7";
+		assert(fromChars(text, f).ec == std::errc::result_out_of_range);
+		text = "2147483647 1/2";
+		assert(fromChars(text, f).ec == std::errc::result_out_of_range);
+
+		int num, den;
+		text = "6/8";
+		fromChars<int>(text.data(), text.data() + text.size(), num, den, ParseFlags::None);
+		assert(num == 6 && den == 8);
+		fromChars<int>(text.data(), text.data() + text.size(), num, den);
+		assert(num == 3 && den == 4);
+		// the most negative numerator still reduces
+		text = "-2147483648/12";
+		assert(fromChars<int>(text.data(), text.data() + text.size(), num, den).ec == std::errc());
+		assert(num == -536870912 && den == 3);
+		text = "-2147483648/1";
+		assert(fromChars<int>(text.data(), text.data() + text.size(), num, den).ec == std::errc());
+		assert(num == std::numeric_limits<int>::min() && den == 1);
+
+		std::vector<int64_t> nums, dens;
+		size_t errors = parseColumn<int64_t>("1/2\n4:6\r\nbad\n2 1/3\n", '\n', nums, dens);
+		assert(errors == 1 && nums.size() == 4);
+		assert(nums[1] == 2 && dens[1] == 3 && dens[2] == 0 && nums[3] == 7 && dens[3] == 3);
+
+		// round trip through the formatter
+		Fraction<int64_t> g = toFract<int64_t>(std::numbers::pi_v<double>, 1E-9);
+		Fraction<int64_t> h;
+		assert(fromChars(toString(g), h).ec == std::errc() && g == h);
+
+		// and through toChars(), which must reject a buffer that is one byte short
+		const Fraction<int64_t> k(-103993, 33102);
+		char buf[13];
+		auto [end, ec] = toChars(buf, buf + sizeof(buf), k);
+		assert(ec == std::errc() && std::string_view(buf, end) == toString(k));
+		assert(fromChars(buf, end, h).ec == std::errc() && h == k);
+		assert(toChars(buf, buf + 12, k).ec == std::errc::value_too_large);
+		assert(toChars(buf, buf + 7, k).ec == std::errc::value_too_large);
+	}
+
+
+
+	void TestMulShift(void)
+	{
+		const double scales[] = { 1.0 / 3.0, 0.7071067811865476, 1.5, 720.0 / 577.0, -0.3 };
+		for (double val : scales) {
+			for (ShiftRounding rounding : { ShiftRounding::Floor, ShiftRounding::Nearest }) {
+				for (ShiftObjective objective : { ShiftObjective::MinimalShift, ShiftObjective::MinimalMultiplier }) {
+					std::optional<MulShift> ms = findMulShift(val, -1000, 4095, 1.5, objective, rounding, 32);
+					assert(ms);
+					for (int64_t x = -1000; x <= 4095; x++) {
+						double e = double(applyMulShift(x, *ms)) - x * val;
+						assert(e >= ms->errorLow - 1E-9 && e <= ms->errorHigh + 1E-9);
+						assert(std::abs(e) <= 1.5);
+					}
+				}
+			}
+		}
+
+		// x / 3 for 8-bit x with a 16-bit product
+		std::optional<MulShift> ms = findMulShift(1.0 / 3.0, 0, 255, 0.999, ShiftObjective::MinimalShift, ShiftRounding::Floor, 16);
+		assert(ms);
+		for (int64_t x = 0; x <= 255; x++)
+			assert(std::abs(double(applyMulShift(x, *ms)) - x / 3.0) <= 0.999);
+
+		assert(!findMulShift(1.0 / 3.0, 0, 1 << 30, 1E-12, ShiftObjective::MinimalShift, ShiftRounding::Floor, 32));
+
+		// the bounds are exact where a double holds them: 3x >> 2 for x * 0.75 only truncates
+		ms = findMulShift(0.75, 0, 1000, 0.8, ShiftObjective::MinimalShift, ShiftRounding::Floor);
+		assert(ms && ms->multiplier == 3 && ms->shift == 2 && ms->errorLow == -0.75 && ms->errorHigh == 0);
+		// and rigorous for a slope error far below 2^-150
+		ms = findMulShift(1E-300, -1000, 1000, 0.5);
+		assert(ms && ms->multiplier == 0 && ms->shift == 0);
+		assert(ms->errorLow <= -1E-297 && ms->errorLow > -1.000001E-297 && ms->errorHigh >= 1E-297 && ms->errorHigh < 1.000001E-297);
+	}
+
+
+
+	void TestPreparedFraction(void)
+	{
+		const Fraction<int64_t> fractions[] = {
+			{ 720, 577 }, { 1, 3 }, { -2, 7 }, { 5, 8 }, { 3, 1 }, { 0, 1 }, { 4294967295LL, 2147483647LL }, { -4294967295LL, 3 }, { 1, 2147483647LL },
+		};
+		std::vector<int32_t> in = { 0, 1, -1, 2, -2, 7, -7, 576, 577, -577, INT32_MAX, INT32_MIN, INT32_MAX - 1, INT32_MIN + 1 };
+		std::mt19937 rng(1);
+		for (int i = 0; i < 1000; i++)
+			in.push_back(int32_t(rng()));
+		std::vector<int64_t> out(in.size());
+
+		for (const Fraction<int64_t> &frac : fractions) {
+			PreparedFraction<int64_t> pf(frac);
+			std::mt19937_64 wide(frac.denominator());
+			for (int i = 0; i < 1000; i++) {
+				const uint64_t n = (i < 2 ? ~uint64_t(0) * uint64_t(i) : wide());
+				assert(pf.divide(n) == n / uint64_t(frac.denominator()));
+			}
+			for (ScaleRounding rounding : { ScaleRounding::Floor, ScaleRounding::Nearest, ScaleRounding::Ceil }) {
+				pf.apply(in, out, rounding);
+				for (size_t i = 0; i < in.size(); i++) {
+					// |in[i] * num| < 2^63: the reference fits in int64
+					int64_t p = int64_t(in[i]) * frac.numerator();
+					int64_t d = frac.denominator();
+					if (rounding == ScaleRounding::Nearest)
+						p += d / 2;
+					else if (rounding == ScaleRounding::Ceil)
+						p += d - 1;
+					int64_t q = p / d - ((p % d) < 0 ? 1 : 0);
+					assert(out[i] == q);
+					assert(pf.apply(in[i], rounding) == q);
+				}
+			}
+		}
+
+		PreparedFraction<int> pf(toFract<int>(320.0 / 241.0, 1E-9));
+		assert(pf.apply(241) == 320 && pf.apply(-241, ScaleRounding::Ceil) == -320);
+	}
+
+
+
+	void TestRationalStepper(void)
+	{
+		const Fraction<int> fractions[] = { { 720, 577 }, { 3, 8 }, { -5, 3 }, { 7, 1 }, { 0, 1 } };
+		for (const Fraction<int> &frac : fractions) {
+			for (int start : { 0, 5, -13 }) {
+				for (int phase : { 0, frac.denominator() / 2 }) {
+					std::vector<int> out(100);
+					fillSteps<int>(frac, out, start, phase);
+					for (int k = 0; k < 100; k++) {
+						int p = (start + k) * frac.numerator() + phase;
+						int q = p / frac.denominator() - (p % frac.denominator() < 0 ? 1 : 0);
+						assert(out[k] == q);
+					}
+				}
+			}
+		}
+
+		// remainders near INT_MAX: rem + stepR would overflow
+		const Fraction<int> wide(INT_MAX - 1, INT_MAX);
+		std::vector<int> steps(100);
+		fillSteps<int>(wide, steps, 0, INT_MAX - 2);
+		for (int k = 0; k < 100; k++)
+			assert(steps[k] == int((int64_t(k) * (INT_MAX - 1) + INT_MAX - 2) / INT_MAX));
+
+		// E(3, 8): three evenly spread events per eight slots
+		std::vector<uint8_t> pattern(16);
+		fillPattern<int>(Fraction<int>(3, 8), pattern);
+		int events = 0;
+		for (size_t k = 0; k < pattern.size(); k++)
+			events += pattern[k];
+		assert(events == 6);
+		assert(std::equal(pattern.begin(), pattern.begin() + 8, pattern.begin() + 8));
+	}
+
+
+
+	void TestTrace(void)
+	{
+		trace::enable();
+		Fraction<int64_t> pi = toFract<int64_t>(std::numbers::pi_v<double>, 1E-9);
+		Fraction<int> third = toFract<int>(1.0 / 3.0);
+		trace::disable();
+		toFract<int>(0.25);
+
+		std::vector<trace::Record> records = trace::snapshot();
+		assert(records.size() >= 4);
+		assert(records.front().kind == trace::Kind::Begin && records.back().kind == trace::Kind::End);
+		assert(records.back().highNum == third.numerator() && records.back().highDen == third.denominator());
+
+		std::stringstream file;
+		trace::write(file, records);
+		std::vector<trace::Record> back = trace::read(file);
+		assert(back.size() == records.size());
+
+		std::ostringstream text;
+		trace::decode(text, back);
+		assert(text.str().find(std::format("answer = {}", pi)) != std::string::npos);
+		assert(text.str().find("x1 = ") != std::string::npos);
+	}
+
+
+
+	void TestContinuedFractionArithmetic(void)
+	{
+		using F = Fraction<int64_t>;
+
+		assert(toFraction(cfSum(cfOf(F(1, 3)), cfOf(F(1, 6))), 1E-15) == F(1, 2));
+		assert(toFraction(cfDifference(cfOf(F(1, 3)), cfOf(F(1, 2))), 1E-15) == F(-1, 6));
+		assert(toFraction(cfProduct(cfOf(F(720, 577)), cfOf(F(-577, 1440))), 1E-15) == F(-1, 2));
+		assert(toFraction(cfQuotient(cfOf(F(16, 9)), cfOf(F(4, 3))), 1E-15) == F(4, 3));
+		assert(toFraction(cfReciprocal(cfOf(F(-7, 3))), 1E-15) == F(-3, 7));
+
+		// a gear chain evaluated with int64_t stream state into an int32_t result
+		CFStreamPtr<int64_t> chain = cfOf(F(46341, 46349));
+		chain = cfProduct(std::move(chain), cfOf(F(46349, 46351)));
+		chain = cfProduct(std::move(chain), cfOf(F(46351, 46341 * 2)));
+		assert((toFraction<int32_t, int64_t>(*chain, 1E-12) == Fraction<int32_t>(1, 2)));
+
+		// sqrt(2) = [1; 2, 2, 2, ...]
+		auto sqrt2 = [] {
+			return std::make_unique<GeneratorCF<int64_t>>([first = true](int64_t &t) mutable { t = first ? 1 : 2; first = false; return true; });
+		};
+		F r = toFraction(cfProduct<int64_t>(sqrt2(), cfOf(F(3, 4))), 1E-15);
+		assert(std::abs(toFloat(r) - 0.75 * std::sqrt(2.0)) < 1E-15);
+
+		Bihomographic<int64_t> square(sqrt2(), sqrt2(), 1, 0, 0, 0, 0, 0, 0, 1);
+		assert(toFraction<int64_t>(square, 1E-15) == F(2) && square.approximate());
+
+		// the fallback term comes from integer floors, also at the ends of the range
+		const int64_t num[3] = { 5, -7, 1 }, den[3] = { 2, 1, 0 };
+		assert(detail::nearestOfInterval(num, den) == -2);
+		const int64_t ends[2] = { INT64_MAX, INT64_MIN }, ones[2] = { 1, 1 };
+		assert(detail::nearestOfInterval(ends, ones) == 0);
+		bool thrown = false;
+		try {
+			detail::mulSub<int64_t>(-1, 1, INT64_MIN);     // -1 - INT64_MIN fits, but not via -(INT64_MIN)
+		}
+		catch (const std::overflow_error &) {
+			thrown = true;
+		}
+		assert(thrown);
+	}
+
+
+
+	void TestFractionPool(void)
+	{
+		using F = Fraction<int64_t>;
+		FractionPool<int64_t> pool;
+
+		assert(pool.intern(F(16, 9)) == 0);
+		assert(pool.intern(F(4, 3)) == 1);
+		assert(pool.intern(F(32, 18)) == 0);
+		assert(pool.find(F(-4, 3)) == std::nullopt);
+		assert(pool[1] == F(4, 3) && pool.size() == 2);
+
+		// overlapping inserts from several threads, across the first few id chunks
+		const int distinct = 5000;
+		std::vector<std::thread> workers;
+		std::vector<std::vector<FractionPool<int64_t>::Id>> ids(4, std::vector<FractionPool<int64_t>::Id>(distinct));
+		for (int t = 0; t < 4; t++) {
+			workers.emplace_back([&pool, &ids, t] {
+				const int stride[] = { 7, 11, 13, 17 };     // coprime to distinct: every thread visits every k
+				for (int i = 0; i < distinct; i++) {
+					int k = (i * stride[t]) % distinct;
+					ids[t][k] = pool.intern(F(k, 1000003));
+				}
+			});
+		}
+		// ... while a reader follows size(): every id it passes must already be written
+		std::atomic<bool> done{ false };
+		std::thread reader([&pool, &done] {
+			while (!done.load()) {
+				const FractionPool<int64_t>::Id last = FractionPool<int64_t>::Id(pool.size() - 1);
+				assert(pool.find(pool.at(last)) == last);
+			}
+		});
+		for (std::thread &w : workers)
+			w.join();
+		done = true;
+		reader.join();
+
+		assert(pool.size() == size_t(distinct) + 2);
+		for (int k = 0; k < distinct; k++) {
+			assert(ids[0][k] == ids[1][k] && ids[1][k] == ids[2][k] && ids[2][k] == ids[3][k]);
+			assert(pool.at(ids[0][k]) == F(k, 1000003));
+		}
+	}
+
+
+
+	void TestFractionIndex(void)
+	{
+		using F = Fraction<int64_t>;
+
+		// all reduced fractions in (0, 2) with denominators up to 60, plus a few near-duplicates far apart in size
+		std::vector<F> catalog;
+		for (int64_t q = 1; q <= 60; q++) {
+			for (int64_t p = 1; p < 2 * q; p++)
+				catalog.push_back(F(p, q));
+		}
+		catalog.push_back(F(INT64_MAX - 1, INT64_MAX));
+		catalog.push_back(F(INT64_MAX - 2, INT64_MAX - 1));
+		FractionIndex<int64_t> index(catalog);
+		assert(std::is_sorted(index.fractions().begin(), index.fractions().end()));
+
+		// exact ordering where a double comparison cannot tell the two apart
+		assert(index.lowerBound(F(INT64_MAX - 2, INT64_MAX - 1)) + 1 == index.lowerBound(F(INT64_MAX - 1, INT64_MAX)));
+		assert(index[index.nearest(std::nextafter(1.0, 0.0))] == F(INT64_MAX - 2, INT64_MAX - 1));
+		assert(index.lowerBound(1.0) == index.lowerBound(F(1)) && index.upperBound(1.0) == index.lowerBound(F(1)) + 1);
+		assert(index[index.nearest(F(1))] == F(1));
+
+		// neighbours whose distances to the query differ by far less than a long double ulp of it
+		const int64_t x = (int64_t(1) << 40) + 1, q = 4194301;
+		std::vector<F> pair = { F(x * q - 1, q), F(x * (q + 1) + 1, q + 1) };
+		assert(FractionIndex<int64_t>(pair).nearest(double(x)) == 1);
+
+		dataset::Options opts;
+		opts.kind = dataset::Distribution::UniformReal;
+		opts.count = 2000;
+		std::vector<double> xs;
+		for (const dataset::Sample &s : dataset::generate(opts))
+			xs.push_back(std::abs(s.value) * 2.2 - 0.1);
+		std::vector<size_t> batch(xs.size());
+		index.nearest<double>(xs, batch);
+
+		for (size_t i = 0; i < xs.size(); i++) {
+			size_t best = 0;
+			for (size_t j = 1; j < index.size(); j++) {
+				if (std::abs(toFloat(index[j]) - xs[i]) < std::abs(toFloat(index[best]) - xs[i]))
+					best = j;
+			}
+			assert(index.nearest(xs[i]) == batch[i]);
+			assert(std::abs(toFloat(index[batch[i]]) - xs[i]) <= std::abs(toFloat(index[best]) - xs[i]));
+		}
+
+		auto r = index.range(F(1, 3), F(1, 2));
+		assert(r.front() == F(1, 3) && r.back() == F(1, 2));
+		assert(index.range(F(2, 5), F(81, 200)).size() == 5);     // 2/5, 23/57, 21/52, 19/47, 17/42
+		assert(index.range(0.4, 0.405).size() == 4);              // the double 0.4 is slightly above 2/5
+		assert(index.range(F(3), F(4)).empty());
+	}
+
+
+
+	void TestSmoothFraction(void)
+	{
+		const int64_t p5[] = { 2, 3, 5 };
+		const int64_t p7[] = { 7, 5, 3, 2 };
+
+		SmoothNumbers<int64_t> hamming(p5, 30);
+		std::vector<int64_t> seq;
+		for (int64_t v; hamming.next(v);)
+			seq.push_back(v);
+		assert((seq == std::vector<int64_t>{ 1, 2, 3, 4, 5, 6, 8, 9, 10, 12, 15, 16, 18, 20, 24, 25, 27, 30 }));
+
+		// 44.1 kHz -> 48 kHz resampling
+		assert(toSmoothFract<int64_t>(48000.0 / 44100.0, 1E-12, p7) == Fraction<int64_t>(160, 147));
+
+		// pi: 355/113 is not 5-smooth; compare with a brute-force search over all denominators
+		auto smooth = [](int64_t v, std::span<const int64_t> primes) {
+			for (int64_t p : primes) {
+				while (v % p == 0)
+					v /= p;
+			}
+			return v == 1;
+		};
+		// (pi with both parts smooth needs 19683/6250 at 1E-2, but already a 48-bit denominator at 1E-4)
+		for (double precision : { 1E-2, 1E-4, 1E-6 }) {
+			for (SmoothPart part : { SmoothPart::Denominator, SmoothPart::Both }) {
+				if (part == SmoothPart::Both && precision < 1E-2)
+					continue;
+				auto r = toSmoothFract<int64_t>(-std::numbers::pi_v<double>, precision, p5, part);
+				assert(r && std::abs(toFloat(*r) + std::numbers::pi_v<double>) < precision);
+				assert(smooth(r->denominator(), p5) && (part == SmoothPart::Denominator || smooth(-r->numerator(), p5)));
+				for (int64_t q = 1; q < r->denominator(); q++) {
+					for (int64_t p = 1; p < 4 * q; p++) {
+						bool ok = smooth(q, p5) && (part == SmoothPart::Denominator || smooth(p, p5));
+						assert(!ok || std::abs(double(p) / double(q) - std::numbers::pi_v<double>) >= precision);
+					}
+				}
+			}
+		}
+
+		// past 2^53 the numerator window no longer holds integers: 3^36 is the first power of 3 within 3E-18 of 0.7
+		const int64_t p3[] = { 3 };
+		assert(toSmoothFract<int64_t>(0.7, 3E-18, p3) == Fraction<int64_t>(105066244707899378LL, 150094635296999121LL));
+
+		// powers of two only reach powers of two
+		const int32_t p2[] = { 2 };
+		assert(!toSmoothFract<int32_t>(3.0, 0.1, p2, SmoothPart::Both));
+		assert(toSmoothFract<int32_t>(0.126, 0.01, p2, SmoothPart::Both) == Fraction<int32_t>(1, 8));
+	}
+
+
+
+	void TestArrowBatch(void)
+	{
+		// a sliced float64 column: rows 1..5 of { x, 0.5, null, -0.75, NaN, 1.25, x }
+		const double values[] = { 9, 0.5, 0, -0.75, std::nan(""), 1.25, 9 };
+		const uint8_t validity[] = { 0x7B };    // row 2 is null
+		const void *buffers[] = { validity, values };
+		ArrowSchema schema{ "g", "ratio", nullptr, ARROW_FLAG_NULLABLE, 0, nullptr, nullptr, [](ArrowSchema *s) { s->release = nullptr; }, nullptr };
+		ArrowArray array{ 5, 1, 1, 2, 0, buffers, nullptr, nullptr, [](ArrowArray *a) { a->release = nullptr; }, nullptr };
+
+		ArrowArray out;
+		ArrowSchema outSchema;
+		arrow::toFractions(schema, array, 1E-9, out, outSchema);
+		assert(std::string_view(outSchema.format) == "+s" && std::string_view(outSchema.name) == "ratio");
+		assert(std::string_view(outSchema.children[1]->name) == "denominator");
+		assert(out.length == 5 && out.null_count == 2 && out.n_children == 2);
+
+		const int64_t *num = static_cast<const int64_t *>(out.children[0]->buffers[1]);
+		const int64_t *den = static_cast<const int64_t *>(out.children[1]->buffers[1]);
+		const uint8_t *valid = static_cast<const uint8_t *>(out.buffers[0]);
+		assert(valid[0] == 0x15);
+		assert(num[0] == 1 && den[0] == 2);
+		assert(num[2] == -3 && den[2] == 4);
+		assert(num[4] == 5 && den[4] == 4);
+
+		// move a child out, then release both
+		ArrowArray denominators = *out.children[1];
+		out.children[1]->release = nullptr;
+		out.release(&out);
+		assert(!out.release && static_cast<const int64_t *>(denominators.buffers[1])[0] == 2);
+		denominators.release(&denominators);
+		outSchema.release(&outSchema);
+
+		const float floats[] = { 0.25f, 3.0f };
+		const void *floatBuffers[] = { nullptr, floats };
+		schema.format = "f";
+		array = ArrowArray{ 2, 0, 0, 2, 0, floatBuffers, nullptr, nullptr, [](ArrowArray *a) { a->release = nullptr; }, nullptr };
+		arrow::toFractions(schema, array, 1E-6, out, outSchema);
+		assert(out.null_count == 0 && out.buffers[0] == nullptr);
+		assert(static_cast<const int64_t *>(out.children[1]->buffers[1])[0] == 4);
+		out.release(&out);
+		outSchema.release(&outSchema);
+	}
+
+
+
+	void TestRatioTracker(void)
+	{
+		FractionBracket<int> bracket;
+		Fraction<int> f = toFract<int>(2.0 / 3.0 + 1E-4, 1E-3, &bracket);
+		assert(f == Fraction<int>(2, 3) && (bracket.low == f || bracket.high == f));
+		assert(toFloat(bracket.low) <= 2.0 / 3.0 + 1E-4 && 2.0 / 3.0 + 1E-4 <= toFloat(bracket.high));
+
+		// the band extends past the held fraction on its own side of the bracket, too
+		RatioTracker<int> tracked(1E-3, 0);
+		tracked.update(2.0 / 3.0 + 1E-4);
+		assert(tracked.update(2.0 / 3.0 - 1E-4) == Fraction<int>(2, 3) && tracked.conversions() == 1);
+
+		// a noisy 3:2 drive: one conversion for the whole stream
+		RatioTracker<int> drive(1E-5);
+		for (int i = 0; i < 1000; i++)
+			drive.update(1.5 + 1E-7 * std::sin(i));
+		assert(drive.value() == Fraction<int>(3, 2) && drive.conversions() == 1);
+		assert(drive.update(-1.5) == Fraction<int>(-3, 2) && drive.changed());
+		assert(drive.update(-1.5 - 1E-7) == Fraction<int>(-3, 2) && drive.update(-1.5 + 1E-7) == Fraction<int>(-3, 2) && drive.conversions() == 2);
+
+		// a ratio dithering on the border of the bands of two neighbouring fractions
+		const double precision = 1E-3;
+		auto run = [precision](double hysteresis, double &worst) {
+			RatioTracker<int> tracker(precision, hysteresis);
+			tracker.update(0.4);    // 2/5, accepted up to 0.4 + 1E-3 / 5
+			worst = 0;
+			size_t switches = 0;
+			for (int i = 0; i < 1000; i++) {
+				double val = 0.4 + precision / 5 + 2E-5 * ((i & 1) ? 1 : -1);
+				const Fraction<int> &held = tracker.update(val);
+				switches += tracker.changed();
+				worst = std::max(worst, std::abs(held.denominator() * val - held.numerator()));
+			}
+			return switches;
+		};
+		double worst;
+		assert(run(0, worst) > 100 && worst < precision);
+		assert(run(0.5, worst) <= 1 && worst < 1.5 * precision);
+	}
+
+
+
+	void TestCoefficientDecoding(void)
+	{
+		const int64_t pi[] = { 3, 7, 15, 1, 292 };
+		assert(fromCoefficients<int64_t>(pi) == Fraction<int64_t>(103993, 33102));
+		std::vector<Fraction<int64_t>> conv = convergentsOf<int64_t>(pi);
+		assert(conv.size() == 5 && conv[1] == Fraction<int64_t>(22, 7) && conv[3] == Fraction<int64_t>(355, 113));
+
+		// [1; 1, 1, ...] = F(n + 1) / F(n): far beyond int64_t, split over several threads
+		using big = boost::multiprecision::cpp_int;
+		std::vector<big> ones(3 * CFParallelMinChunk, 1);
+		Fraction<big> golden = fromCoefficients<big>(ones, 4);
+		assert(golden == fromCoefficients<big>(ones, 1));
+		std::vector<Fraction<big>> goldenConv = convergentsOf<big>(ones, 3);
+		assert(goldenConv.back() == golden && goldenConv[10] == Fraction<big>(144, 89));
+
+		// batches of short sequences, including ones the vector lanes hand back to the scalar loop
+		std::vector<int64_t> terms;
+		std::vector<size_t> offsets = { 0 };
+		std::vector<std::vector<int64_t>> seqs = {
+			{ 3, 7, 15, 1, 292 }, { -2, 3 }, { 5 }, { 0, 1, 2, 3, 4, 5, 6 }, { 1, 4294967296 }, { 0, 65536, 65536, 65536 },
+			std::vector<int64_t>(40, 1), { 7, 1 }, { 0, 2 },
+		};
+		for (const auto &seq : seqs) {
+			terms.insert(terms.end(), seq.begin(), seq.end());
+			offsets.push_back(terms.size());
+		}
+		std::vector<int64_t> num(seqs.size()), den(seqs.size());
+		fromCoefficients(terms, offsets, num, den);
+		for (size_t k = 0; k < seqs.size(); k++)
+			assert(Fraction<int64_t>(num[k], den[k]) == fromCoefficients<int64_t>(seqs[k]) && den[k] > 0);
+		assert(num[1] == -5 && den[1] == 3);
+
+		bool thrown = false;
+		try {
+			const int64_t bad[] = { 1, 2, 0, 3 };
+			fromCoefficients<int64_t>(bad);
+		}
+		catch (const std::invalid_argument &) {
+			thrown = true;
+		}
+		assert(thrown);
+	}
+
+	void TestExactBracketing(void)
+	{
+		// negative values go through their magnitude: -1E-30 must not turn into 1 - 1E-30 == 1
+		assert(toFract<int64_t>(-0.75, 1E-9) == Fraction<int64_t>(-3, 4));
+		FractionBracket<int32_t> tiny;
+		assert(toFract<int32_t>(-1E-30, 1E-9, &tiny) == Fraction<int32_t>(0, 1));
+		assert(tiny.low < Fraction<int32_t>(0, 1) && tiny.high == Fraction<int32_t>(0, 1));
+
+		// step counts rounded up by x1 / x2 used to step past val
+		assert(toFract<int32_t>(1.0 / 18 + 0x1p-56, 1E-6) == Fraction<int32_t>(1, 18));
+		assert(toFract<int64_t>(0.10674957059714629, 1E-9) == Fraction<int64_t>(44384307, 415779724));
+
+		// denominators beyond 2^53: the residuals are formed exactly, not from rounded products
+		FractionBracket<int64_t> bracket;
+		assert(toFract<int64_t>(0x1.81f523d7b457bp-3, 0x1p-58, &bracket) == Fraction<int64_t>(6789837520323963, 36028797018963968));
+		assert(bracket.high == Fraction<int64_t>(8391342253314101, 44526833794821709));
+		// ... and when the range runs out the closer end is the answer
+		assert(toFract<int64_t>(0x1.96a446e2fa60ep-55, 0x1p-67) == Fraction<int64_t>(333, 7553044456800309619));
+	}
+
+	void TestSarPlanner(void)
+	{
+		// PAL 16:9 anamorphic, mod 16: the source size itself with SAR 64:45
+		SarConstraints mod16;
+		mod16.widthMultiple = mod16.heightMultiple = 16;
+		SarPlan pal = SarPlanner(720, 576, Fraction<int64_t>(16, 9), mod16).plan(576).front();
+		assert(pal.width == 720 && pal.height == 576 && pal.sar == Fraction<int64_t>(64, 45) && pal.aspectError == 0);
+
+		// NTSC with the ITU 16:9 aspect: SAR 5760:4739 fits the 16-bit terms as it is
+		SarPlan ntsc = SarPlanner(720, 480, Fraction<int64_t>(8640, 4739)).plan(480).front();
+		assert(ntsc.width == 720 && ntsc.sar == Fraction<int64_t>(5760, 4739) && ntsc.aspectError == 0);
+
+		// square pixel ladder: 853.33 rounds to the even 854
+		SarConstraints square;
+		square.pixels = PixelAspect::Square;
+		SarPlanner ladder(1920, 1080, Fraction<int64_t>(16, 9), square);
+		const int64_t heights[] = { 1080, 720, 480, 360 };
+		std::vector<SarPlan> rungs = ladder.planLadder(heights);
+		const int64_t widths[] = { 1920, 1280, 854, 640 };
+		for (size_t i = 0; i < rungs.size(); i++) {
+			assert(rungs[i].width == widths[i] && rungs[i].height == heights[i] && rungs[i].sar == Fraction<int64_t>(1));
+			assert(rungs[i].width == ladder.plan(heights[i]).front().width);
+		}
+
+		// a 4:3 rung capped by the maximum width
+		square.maxWidth = 1280;
+		SarPlan capped = SarPlanner(1440, 1080, Fraction<int64_t>(4, 3), square).plan(1080).front();
+		assert(capped.width == 1280 && capped.height == 960);
+
+		// SAR terms beyond 65535: the closest fraction within them, against a scan of all denominators
+		Fraction<int64_t> dar(123457, 65537);
+		SarPlan odd = SarPlanner(1000, 999, dar).plan(999).front();
+		assert(odd.sar.numerator() <= 65535 && odd.sar.denominator() <= 65535);
+		Fraction<int64_t> exact(dar.numerator() * odd.height, dar.denominator() * odd.width);
+		assert(exact != odd.sar);
+		double best = std::abs(toFloat(odd.sar) - toFloat(exact));
+		for (int64_t q = 1; q <= 65535; q++) {
+			int64_t p = std::llround(toFloat(exact) * double(q));
+			if (p >= 1 && p <= 65535)
+				assert(std::abs(double(p) / double(q) - toFloat(exact)) >= best * (1 - 1E-9));
+		}
+		assert(boundedFraction(Fraction<int64_t>(1000000, 3), 65535) == Fraction<int64_t>(65535, 1));
+		assert(boundedFraction(Fraction<int64_t>(355, 113), 350) == Fraction<int64_t>(333, 106));
+
+		// an extreme source shape: output widths stay below 2^31, and a rung without one throws
+		SarConstraints unaligned;
+		unaligned.widthMultiple = unaligned.heightMultiple = 1;
+		SarPlan wide = SarPlanner(2147483647, 1, Fraction<int64_t>(16, 9), unaligned).plan(1).front();
+		assert(wide.height == 1 && wide.width < (int64_t(1) << 31) && wide.width >= 2147483646);
+		bool thrown = false;
+		try {
+			SarPlanner(2147483647, 1, Fraction<int64_t>(16, 9)).plan(1000);
+		}
+		catch (const std::invalid_argument &) {
+			thrown = true;
+		}
+		assert(thrown);
+
+		thrown = false;
+		try {
+			SarConstraints none;
+			none.widthMultiple = 0;
+			SarPlanner(720, 576, Fraction<int64_t>(4, 3), none);
+		}
+		catch (const std::invalid_argument &) {
+			thrown = true;
+		}
+		assert(thrown);
+	}
+
+	void TestSternBrocotKey(void)
+	{
+		// 1 = the empty path, 2 = R, 1/2 = L, 3/5 = [0; 1, 1, 2] = L R L
+		assert(sternBrocotKey(Fraction<int64_t>(1)) == std::string("\x03\x80"));
+		assert(sternBrocotKey(Fraction<int64_t>(2)) == std::string("\x03\xC0\x01\xFF"));
+		assert(sternBrocotKey(Fraction<int64_t>(3, 5)) == std::string("\x03\x40\xFE\x01\xFE\x00", 6));
+
+		// memcmp order is numeric order, and every key decodes to its value
+		const int64_t big = std::numeric_limits<int64_t>::max();
+		std::vector<Fraction<int64_t>> values = {
+			Fraction<int64_t>(0), Fraction<int64_t>(big), Fraction<int64_t>(-big), Fraction<int64_t>(1, big),
+			Fraction<int64_t>(std::numeric_limits<int64_t>::min()), Fraction<int64_t>(big - 1, big), Fraction<int64_t>(103993, 33102),
+		};
+		std::mt19937_64 rng(96);
+		for (int i = 0; i < 3000; i++) {
+			int64_t q = 1 + int64_t(rng() % (i % 3 == 0 ? 1000000000000 : 40));
+			int64_t p = int64_t(rng() % 100000000000000) - 50000000000000;
+			values.emplace_back(i % 2 ? p % 200 : p, q);
+		}
+		std::vector<std::string> keys;
+		for (const auto &v : values) {
+			keys.push_back(sternBrocotKey(v));
+			size_t used = 0;
+			assert(fromSternBrocotKey<int64_t>(keys.back() + "tail", &used) == v && used == keys.back().size());
+		}
+		for (size_t i = 0; i < values.size(); i += 7) {
+			for (size_t j = 0; j < values.size(); j++) {
+				int c = keys[i].compare(keys[j]);
+				assert((c < 0) == (values[i] < values[j]) && (c == 0) == (values[i] == values[j]));
+			}
+		}
+
+		// subtree key ranges against a Stern-Brocot descent
+		auto descends = [](const Fraction<int64_t> &node, Fraction<int64_t> x) {
+			if ((node < 0) != (x < 0))
+				return false;
+			const int64_t sign = (node < 0 ? -1 : 1);
+			int64_t lp = 0, lq = 1, hp = 1, hq = 0;
+			for (x *= sign;;) {
+				Fraction<int64_t> m(lp + hp, lq + hq);
+				if (m == node * sign)
+					return true;
+				if (m == x)
+					return false;
+				if (x < m)
+					hp = m.numerator(), hq = m.denominator();
+				else
+					lp = m.numerator(), lq = m.denominator();
+			}
+		};
+		for (const Fraction<int64_t> &node : { Fraction<int64_t>(1), Fraction<int64_t>(3, 5), Fraction<int64_t>(-7, 2), Fraction<int64_t>(4) }) {
+			auto [low, high] = sternBrocotSubtree(node);
+			for (int64_t q = 1; q <= 12; q++) {
+				for (int64_t p = -40; p <= 40; p++) {
+					if (p == 0)
+						continue;
+					std::string k = sternBrocotKey(Fraction<int64_t>(p, q));
+					assert((low < k && k < high) == descends(node, Fraction<int64_t>(p, q)));
+				}
+			}
+		}
+
+		bool thrown = false;
+		try {
+			fromSternBrocotKey<int32_t>(sternBrocotKey(Fraction<int64_t>(int64_t(1) << 40, 3)));
+		}
+		catch (const std::overflow_error &) {
+			thrown = true;
+		}
+		assert(thrown);
+		thrown = false;
+		try {
+			fromSternBrocotKey<int64_t>(std::string("\x03\xC0\x01", 3));
+		}
+		catch (const std::invalid_argument &) {
+			thrown = true;
+		}
+		assert(thrown);
+	}
+
+	void TestConstantRecognizer(void)
+	{
+		ConstantRecognizer recognizer;
+		auto named = [&recognizer](double val) {
+			auto r = recognizer.recognize(val);
+			return r ? recognizer.toString(*r) : std::string("-");
+		};
+		const double pi = std::numbers::pi_v<double>;
+		assert(named(3 * pi / 4) == "3/4*pi");
+		assert(named(1 / std::sqrt(2.0)) == "1/2*sqrt(2)");
+		assert(named(-2 * std::numbers::ln2_v<double>) == "-2*ln2");
+		assert(named(0.1) == "1/10");
+		assert(named(7) == "7");
+		assert(named(std::numbers::e_v<double> / 3) == "1/3*e");
+		assert(named(0) == "0");
+		// no small multiple of any of them
+		assert(named(0.123456789012345) == "-");
+		assert(named(pi * pi) == "-");
+
+		// the capped descent the candidates use stops at the closest end within the cap
+		FractionBracket<int64_t> capped;
+		assert(toFract<int64_t>(pi, 1E-12, &capped, int64_t(1000)) == Fraction<int64_t>(355, 113));
+		assert(capped.low < Fraction<int64_t>(355, 113) && capped.high.denominator() <= 1000);
+		assert(toFract<int64_t>(-pi, 1E-12, nullptr, int64_t(7)) == Fraction<int64_t>(-22, 7));
+
+		// user constants, and the batch
+		std::vector<NamedConstant> constants = ConstantRecognizer::defaultConstants();
+		constants.push_back({ "phi", std::numbers::phi_v<double> });
+		constants.push_back(ConstantRecognizer::squareRoot(7));
+		ConstantRecognizer extended(constants);
+		const double values[] = { 5 * std::numbers::phi_v<double> / 2, 2 * std::sqrt(7.0), pi / 180, std::nan(""), 1E300 };
+		std::vector<std::optional<RecognizedConstant>> out(std::size(values));
+		extended.recognize(values, out);
+		for (size_t i = 0; i < std::size(values); i++) {
+			auto single = extended.recognize(values[i]);
+			assert(bool(single) == bool(out[i]) && (!single || (single->multiple == out[i]->multiple && single->constant == out[i]->constant)));
+		}
+		assert(extended.toString(*out[0]) == "5/2*phi" && extended.toString(*out[1]) == "2*sqrt(7)" && extended.toString(*out[2]) == "1/180*pi");
+		assert(!out[3] && !out[4]);
+	}
+
+	void TestIntegerRelation(void)
+	{
+		// double-double keeps what double rounds away
+		DoubleDouble tiny = DoubleDouble(1) + DoubleDouble(0x1p-60);
+		assert(tiny.hi == 1 && tiny.lo == 0x1p-60);
+		DoubleDouble root2 = sqrt(DoubleDouble(2));
+		assert(std::abs(double(root2 * root2 - DoubleDouble(2))) < 1E-30);
+
+		auto relation = [](std::vector<double> x, const RelationOptions &opts = {}) {
+			IntegerRelationFinder<> finder(x.size(), opts);
+			std::vector<int64_t> a(x.size());
+			finder.find(x, a);
+			return a;
+		};
+		// n = 2: the relation toFract() finds, 3 * 1 - 4 * 0.75 == 0
+		assert((relation({ 1, 0.75 }) == std::vector<int64_t>{ 3, -4 }));
+		// ln 6 = ln 2 + ln 3
+		assert((relation({ std::log(2.0), std::log(3.0), std::log(6.0) }) == std::vector<int64_t>{ 1, 1, -1 }));
+		// the minimal polynomial of 2^(1/3): a^3 - 2 == 0
+		const double c = std::cbrt(2.0);
+		assert((relation({ 1, c, c * c, c * c * c }) == std::vector<int64_t>{ 2, 0, 0, -1 }));
+		// gains 0.3 and 0.45 among unrelated channels, and a zero channel
+		assert((relation({ 0.3, 0.45, std::numbers::pi_v<double>, std::sqrt(5.0) }) == std::vector<int64_t>{ 3, -2, 0, 0 }));
+		assert((relation({ 0.3, 0, 0.7 }) == std::vector<int64_t>{ 0, 1, 0 }));
+		// 1, sqrt 2, sqrt 3 have no relation; not within the bound, and the search says so
+		RelationOptions bounded;
+		bounded.maxCoefficient = 1000;
+		assert((relation({ 1, std::sqrt(2.0), std::sqrt(3.0) }, bounded) == std::vector<int64_t>{ 0, 0, 0 }));
+
+		// the batch, and plain double arithmetic for an easy case
+		const double rows[] = { 1, 0.75, 2, 5, 1, std::numbers::pi_v<double> };
+		int64_t out[6];
+		IntegerRelationFinder<> batch(2, bounded);
+		assert(batch.find(rows, out, 3) == 2);
+		assert(out[0] == 3 && out[1] == -4 && out[2] == 5 && out[3] == -2 && out[4] == 0 && out[5] == 0);
+		IntegerRelationFinder<double> plain(3);
+		int64_t a[3];
+		const double logs[] = { std::log(2.0), std::log(3.0), std::log(6.0) };
+		assert(plain.find(logs, a) && a[0] == 1 && a[1] == 1 && a[2] == -1);
+	}
+
+	void TestSqrtFract(void)
+	{
+		// sqrt(2) = [1; 2, 2, ...]: 1393/985 is the last convergent below 1000
+		assert(sqrtFract<int64_t>(Fraction<int64_t>(2), 1000) == Fraction<int64_t>(1393, 985));
+		SqrtExpansion<int64_t> seven(Fraction<int64_t>(7));
+		SqrtExpansion<int64_t>::wide_type a;
+		std::vector<int64_t> terms;
+		for (size_t i = 0; i < 9 && seven.term(i, a); i++)
+			terms.push_back(int64_t(a));
+		assert((terms == std::vector<int64_t>{ 2, 1, 1, 1, 4, 1, 1, 1, 4 }) && seven.preperiod() == 1 && seven.period() == 4);
+
+		// 1/sqrt(2) far beyond double: |q^2 - 2 p^2| <= 2, an error of about 1 / q^2
+		const int64_t bound = int64_t(1) << 62;
+		Fraction<int64_t> half = sqrtFract<int64_t>(Fraction<int64_t>(1, 2), bound);
+		__int128 pell = (__int128)half.denominator() * half.denominator() - 2 * (__int128)half.numerator() * half.numerator();
+		assert(half.denominator() > (int64_t(1) << 60) && pell != 0 && pell >= -2 && pell <= 2);
+
+		// perfect squares are exact; 0 too
+		assert(sqrtFract<int32_t>(Fraction<int32_t>(8, 18), 100) == Fraction<int32_t>(2, 3));
+		assert(sqrtFract<int32_t>(Fraction<int32_t>(0), 100) == Fraction<int32_t>(0));
+		// int32_t: the numerator runs out first
+		Fraction<int32_t> big = sqrtFract<int32_t>(Fraction<int32_t>(1000000), std::numeric_limits<int32_t>::max());
+		assert(big == Fraction<int32_t>(1000));
+		Fraction<int32_t> wide = sqrtFract<int32_t>(Fraction<int32_t>(999999), std::numeric_limits<int32_t>::max());
+		assert(wide.numerator() > 1000000000 && std::abs(toFloat(wide) - std::sqrt(999999.0)) < 1E-9);
+
+		// against the closest fraction over every denominator, compared exactly
+		using rational = boost::multiprecision::cpp_rational;
+		auto closer = [](const rational &a, const rational &b, const rational &r) {
+			// |a - sqrt(r)| < |b - sqrt(r)|, for a != b
+			const rational m = (a + b) / 2;
+			return (a < b) == (m * m > r);
+		};
+		const Fraction<int64_t> radicands[] = { Fraction<int64_t>(2), Fraction<int64_t>(3), Fraction<int64_t>(5, 7), Fraction<int64_t>(7, 3),
+			Fraction<int64_t>(13), Fraction<int64_t>(1, 2), Fraction<int64_t>(10), Fraction<int64_t>(99, 100), Fraction<int64_t>(4, 9),
+			Fraction<int64_t>(19, 5) };
+		for (const Fraction<int64_t> &r : radicands) {
+			const rational rr(r.numerator(), r.denominator());
+			for (int64_t b = 1; b <= 120; b++) {
+				Fraction<int64_t> f = sqrtFract<int64_t>(r, b);
+				assert(f.denominator() <= b);
+				const rational fr(f.numerator(), f.denominator());
+				for (int64_t q = 1; q <= b; q++) {
+					int64_t p = int64_t(detail::isqrt<__int128>((__int128)q * q * r.numerator() / r.denominator()));
+					for (int64_t c : { p, p + 1 }) {
+						const rational cr(c, q);
+						assert(cr == fr || !closer(cr, fr, rr));
+					}
+				}
+			}
+		}
+	}
+
+
+
 	void TestFractionConversion(void) {
 		Test<int>();
 		Test<long>();
 		Test<int32_t>();
 		Test<int64_t>();
+
+		TestOverflowGuard();
+		TestDatasetGenerator();
+		TestShardPlan();
+		TestFractionParse();
+		TestMulShift();
+		TestPreparedFraction();
+		TestRationalStepper();
+		TestTrace();
+		TestContinuedFractionArithmetic();
+		TestFractionPool();
+		TestFractionIndex();
+		TestSmoothFraction();
+		TestArrowBatch();
+		TestRatioTracker();
+		TestCoefficientDecoding();
+		TestExactBracketing();
+		TestSarPlanner();
+		TestSternBrocotKey();
+		TestConstantRecognizer();
+		TestIntegerRelation();
+		TestSqrtFract();
 	}
 }
 
@@ -0,0 +1,36 @@
+
+#include "./fraction_trace.h"
+
+#include <fstream>
+#include <iostream>
+
+using namespace cvt_2_fraction;
+
+
+#if defined(BUILD_MONOLITHIC)
+#define main cvt2frac_trace_decode_main
+#endif
+
+extern "C"
+int main(int argc, const char **argv) {
+	if (argc < 2) {
+		std::cerr << std::format("Usage: {} TRACEFILE...\n\nPrints binary toFract() traces (see trace::write()) as readable text.\n", argv[0]);
+		return 1;
+	}
+
+	try {
+		for (int i = 1; i < argc; i++) {
+			std::ifstream file(argv[i], std::ios::binary);
+			if (!file) {
+				std::cerr << std::format("cannot open {}\n", argv[i]);
+				return 1;
+			}
+			trace::decode(std::cout, trace::read(file));
+		}
+	}
+	catch (const std::exception &ex) {
+		std::cerr << ex.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}